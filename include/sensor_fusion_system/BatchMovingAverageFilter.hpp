@@ -0,0 +1,72 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file BatchMovingAverageFilter.hpp
+ * @brief Structure-of-arrays moving average filter for evaluating many instances in lockstep
+ * @version 1.0
+ * @date 2024-02-18
+ */
+
+#ifndef BATCH_MOVING_AVERAGE_FILTER_HPP_
+#define BATCH_MOVING_AVERAGE_FILTER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "sensor_fusion_system/MovingAverageFilter.hpp"
+
+namespace Xycar {
+/**
+ * @brief N independent moving average filters with the results of MovingAverageFilter
+ *
+ * All instances share the sample size and receive one sample each per step. Instead of
+ * re-summing the window, the plain and weighted sums are updated incrementally:
+ * S' = S - oldest + x and, with weights 1..n from the oldest, W' = W - S + n * x.
+ *
+ * @tparam PREC Precision of data
+ * @tparam FilteringMode
+ */
+template <typename PREC, FilteringMode Mode = FilteringMode::WEIGHTED>
+class BatchMovingAverageFilter final
+{
+public:
+    using Ptr = BatchMovingAverageFilter*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Batch Moving Average Filter object
+     *
+     * @param[in] sampleSize Window size shared by all instances, at least 1
+     * @param[in] numInstances Number of filters
+     */
+    BatchMovingAverageFilter(uint32_t sampleSize, size_t numInstances);
+
+    /**
+     * @brief Add one new sample to every filter
+     *
+     * @param[in] newSamples numInstances samples, one per filter
+     */
+    void addSamples(const int32_t* newSamples);
+
+    /**
+     * @brief Get the filtered data
+     *
+     * @return numInstances results, valid until the next addSamples
+     */
+    const PREC* getResults() const { return mFilteringResults.data(); }
+
+    size_t size() const { return mNumInstances; }
+
+private:
+    const uint32_t mSampleSize;            ///< Window size
+    const size_t mNumInstances;            ///< Number of filters
+    uint32_t mNumSamples = 0;              ///< Samples in the window, up to mSampleSize
+    uint32_t mHead = 0;                    ///< Window slot overwritten by the next step
+    std::vector<int32_t> mSamples;         ///< mSampleSize rows of mNumInstances samples
+    std::vector<int32_t> mSums;            ///< Sum of the window per filter
+    std::vector<int32_t> mWeightedSums;    ///< Weighted sum of the window per filter
+    std::vector<PREC> mFilteringResults;   ///< Result per filter
+};
+} // namespace Xycar
+
+#endif // BATCH_MOVING_AVERAGE_FILTER_HPP_
@@ -0,0 +1,65 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file BatchPIDController.hpp
+ * @brief Structure-of-arrays PID for evaluating many gain sets in lockstep
+ * @version 1.0
+ * @date 2024-02-18
+ */
+
+#ifndef BATCH_PID_CONTROLLER_HPP_
+#define BATCH_PID_CONTROLLER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+namespace Xycar {
+/**
+ * @brief N independent PID controllers with the same update as PIDController
+ *
+ * Gains and state are stored per field in contiguous arrays, so one step is a single
+ * branch-free loop over the instances that the compiler turns into SIMD code.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class BatchPIDController final
+{
+public:
+    using Ptr = BatchPIDController*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Batch PID Controller object, one instance per gain triple
+     *
+     * @param[in] pGains Proportional control gain of each instance
+     * @param[in] iGains Integral control gain of each instance
+     * @param[in] dGains Differential control gain of each instance
+     */
+    BatchPIDController(const std::vector<PREC>& pGains, const std::vector<PREC>& iGains, const std::vector<PREC>& dGains);
+
+    /**
+     * @brief Advance every instance by one step
+     *
+     * @param[in] errors Error of each instance
+     * @param[out] outputs Control output of each instance
+     */
+    void getControlOutput(const PREC* errors, PREC* outputs);
+
+    /**
+     * @brief Clear the integral and differential state of every instance
+     */
+    void reset();
+
+    size_t size() const { return mProportionalGain.size(); }
+
+private:
+    std::vector<PREC> mProportionalGain;      ///< Proportional control gain per instance
+    std::vector<PREC> mIntegralGain;          ///< Integral control gain per instance
+    std::vector<PREC> mDifferentialGain;      ///< Differential control gain per instance
+    std::vector<PREC> mProportionalGainError; ///< Last error per instance
+    std::vector<PREC> mIntegralGainError;     ///< Accumulated error per instance
+};
+} // namespace Xycar
+
+#endif // BATCH_PID_CONTROLLER_HPP_
@@ -6,31 +6,70 @@
 #include <yaml-cpp/yaml.h>
 #include <fstream>
 
+#include "sensor_fusion_system/CropClassifier.hpp"
+#include "sensor_fusion_system/ProjectionLookupTable.hpp"
+#include "sensor_fusion_system/TaskPool.hpp"
+#include "sensor_fusion_system/UndistortGrid.hpp"
+
 /// create your lane detecter
 /// Class naming.. it's up to you.
 namespace Xycar {
+/// Detection that survived NMS, with the lidar points that project inside it
+struct Detection
+{
+    cv::Rect box;                  /// Bounding box in the undistorted image
+    cv::Rect frameBox;             /// Bounding box in the debug frame, the raw box in POINTS mode, box otherwise
+    int32_t classId;               /// Class index into the label file
+    float confidence;              /// Detector confidence
+    std::vector<int> pointIndices; /// Indices of the lidar image points inside the box
+    int32_t subClassId = -1;       /// Class of the crop classifier, -1 if not classified
+    float subConfidence = 0.f;     /// Crop classifier confidence
+};
+
 template <typename PREC>
 class CameraDetector final
 {
 public:
     using Ptr = CameraDetector*; /// < Pointer type of the class(it's up to u)
+    using TablePtr = typename ProjectionLookupTable<PREC>::Ptr; /// < Pointer type of ProjectionLookupTable
+    using GridPtr = typename UndistortGrid<PREC>::Ptr; /// < Pointer type of UndistortGrid
 
     static inline const cv::Scalar kRed = {0, 0, 255}; /// Scalar values of Red
     static inline const cv::Scalar kGreen = {0, 255, 0}; /// Scalar values of Green
     static inline const cv::Scalar kBlue = {255, 0, 0}; /// Scalar values of Blue
+    static constexpr float kLidarPlaneY = -0.058f; /// Height of the scan plane in the lidar object frame
 
-    CameraDetector(const YAML::Node& config) {setConfiguration(config);}
+    CameraDetector(const YAML::Node& config, TaskPool::Ptr taskPool) : mTaskPool(taskPool) {setConfiguration(config);}
+    ~CameraDetector() {delete mProjectionTable; delete mCropClassifier; delete mUndistortGrid;}
     void undistortAndDNNConfig();
     std::vector<int> boundingBox(const cv::Mat img, const std::vector<cv::Point2f> lidarImagePoints);
+
+    // Steps of boundingBox, exposed so the pipeline can schedule them as separate stages
+    void undistort(const cv::Mat& img);                                 /// Undistort img into the debug frame, or copy it in POINTS mode
+    void detect();                                                      /// YOLO on the debug frame, detections without points in the undistorted image
+    void classify(const cv::Mat& img);                                  /// Crop classifier on the detections, crops taken from the raw img
+    void associate(const std::vector<cv::Point2f>& lidarImagePoints);   /// Lidar image points inside each detection
+    void associate(const std::vector<cv::Point2f>& lidarImagePoints, std::vector<Detection>& detections) const; /// Same for other detections
+    void draw(const std::vector<cv::Point2f>& lidarImagePoints);        /// Boxes, labels and associated points on the debug frame
+    void show() const;                                                  /// Debug frame in a HighGUI window if DEBUG, main thread only
     void getLidarExtrinsicMatrix(std::vector<cv::Point2f> imagePoints, std::vector<cv::Point3f> objectPoints);
     void getVCSExtrinsicMatrix(std::vector<cv::Point2f> imagePoints, std::vector<cv::Point3f> objectPoints);
     cv::Point3f getVCSCoordPointsFromLidar(cv::Point3f objectPoint);
+    bool getGroundPoint(const cv::Rect& box, cv::Point3f& vcs) const; /// VCS point where the bottom center of box meets the ground
     std::vector<cv::Point2f> getProjectPoints(std::vector<cv::Point3f>& objectPoints);
+    std::vector<cv::Point2f> getProjectPoints(std::vector<cv::Point3f>& objectPoints, std::vector<int>& beamIndices, std::vector<float>& ranges);
+    void setScanGeometry(PREC angleMin, PREC angleIncrement, uint32_t numBeams);
+    const std::vector<int>& getVisibleBeams() const {return mVisibleBeams;}
+    static cv::Point3f toLidarObjectPoint(PREC angle, PREC range);
 
     std::vector<cv::Point2f> Generate2DPoints();
     std::vector<cv::Point3f> Generate3DLidarPoints();
     std::vector<cv::Point3f> Generate3DVCSPoints();
 
+    const std::vector<Detection>& getDetections() const {return mDetections;}
+    const cv::Mat& getDebugFrame() const {return mTemp;}
+    double getInferenceTime() const {return mInferenceTime;}
+
 private:
     int32_t mImageWidth;
     int32_t mImageHeight;
@@ -46,7 +85,51 @@ private:
     cv::Mat mVCSRvec;
     cv::Mat mVCSTvec;
 
+    // Ground plane fallback, camera ray of an undistorted pixel in the VCS calibration frame
+    cv::Matx33d mGroundRayMatrix;   /// < R^T * K^-1, pixel to ray direction
+    cv::Vec3d mCameraCenter;        /// < Camera position in the calibration frame
+    double mGroundHeight;           /// < Height of the ground along the calibration frame y axis (down)
+    double mGroundRangeMax;         /// < Farther intersections are rejected, the ray is close to the horizon
+
+    // POINTS undistortion: detect on the raw frame and only undistort the box outlines, nullptr in FRAME mode
+    GridPtr mUndistortGrid = nullptr;
+    cv::Rect undistortBox(const cv::Rect& box) const;
+
+    // Shared with the node, runs the per-layer decode and the per-box association
+    TaskPool::Ptr mTaskPool;
+
+    // Lidar projection lookup table, rebuilt whenever the scan geometry or the lidar extrinsics change
+    TablePtr mProjectionTable = nullptr;
+    PREC mScanAngleMin = 0.0;
+    PREC mScanAngleIncrement = 0.0;
+    uint32_t mScanNumBeams = 0;
+    void updateProjectionTable();
+
+    // Beams that can land inside the image for some range, computed once per calibration
+    bool mFrustumCulling;
+    PREC mFrustumRangeMin;
+    PREC mFrustumRangeMax;
+    std::vector<int> mVisibleBeams;
+    void updateVisibleBeams();
+
     cv::dnn::Net mNeuralNet;
+    cv::dnn::Net loadNetwork() const;
+    void forward(cv::dnn::Net& net, const cv::Mat& blob, std::vector<cv::Mat>& outs);
+    void decode(const std::vector<cv::Mat>& outs, const std::vector<cv::Rect>& regions, float threshold,
+                std::vector<int>& classIds, std::vector<float>& confidences, std::vector<cv::Rect>& boxes);
+
+    // Two-stage detection: low resolution proposals over the frame, then native resolution crops in one batch
+    int32_t mInputSize;         /// < Network input of the single pass
+    bool mTwoStage;
+    int32_t mProposalSize;      /// < Network input of the proposal pass
+    float mProposalThreshold;   /// < Confidence a proposal needs to get a crop
+    int32_t mRefineSize;        /// < Network input of each crop, also the smallest crop side
+    float mCropMargin;          /// < Context around a proposal, fraction of its larger side
+    int32_t mMaxCrops;          /// < Crops per frame, the refinement batch size
+    cv::dnn::Net mProposalNet;
+    cv::Mat mEmptyCrop;         /// < Pads the refinement batch
+
+    CropClassifier::Ptr mCropClassifier = nullptr; /// < Fine-grained class of the detections, only created when enabled
 
     std::string mYoloConfig;
     std::string mYoloModel;
@@ -54,6 +137,8 @@ private:
 
     std::vector<std::string> mClassNames;
     std::vector<std::string> mOutputLayers;
+    std::vector<Detection> mDetections;
+    double mInferenceTime = 0.0; /// < Time (ms) of the network forwards of the last frame
 
     const float mConfThreshold = 0.5f;
     const float mNmsThreshold = 0.4f;
@@ -0,0 +1,79 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file CropClassifier.hpp
+ * @brief Second stage classifier of detector boxes, one batched forward per frame
+ * @version 1.0
+ * @date 2024-02-23
+ */
+
+#ifndef CROP_CLASSIFIER_HPP_
+#define CROP_CLASSIFIER_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "opencv2/dnn.hpp"
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+/**
+ * @brief Tiny classification network run on the crops of the detector boxes (traffic light state, sign type)
+ *
+ * Boxes are in the undistorted image, but only the crops are undistorted: the undistortion maps under each
+ * box are resized to the network input and the raw frame is remapped through them, so the full frame
+ * never has to be remapped. All crops of a frame go through the network as one batch.
+ */
+class CropClassifier final
+{
+public:
+    using Ptr = CropClassifier*; ///< Pointer type of this class
+
+    /**
+     * @param[in] config CLASSIFIER section of the configuration
+     */
+    CropClassifier(const YAML::Node& config);
+
+    /**
+     * @brief Undistortion maps of the detector, from undistorted pixel to raw pixel
+     */
+    void setUndistortMaps(const cv::Mat& map1, const cv::Mat& map2);
+
+    /**
+     * @brief Classify the boxes whose detector class is refined
+     *
+     * @param[in] raw Distorted camera frame
+     * @param[in] boxes Boxes in the undistorted image
+     * @param[in] detectorClassIds Detector class of each box
+     * @param[out] classIds Classifier class of each box, -1 if not classified
+     * @param[out] confidences Classifier confidence of each box
+     */
+    void classify(const cv::Mat& raw, const std::vector<cv::Rect>& boxes, const std::vector<int32_t>& detectorClassIds,
+                  std::vector<int32_t>& classIds, std::vector<float>& confidences);
+
+    const std::string& getClassName(int32_t classId) const { return mClassNames[classId]; }
+
+private:
+    bool isRefined(int32_t detectorClassId) const;
+
+    cv::dnn::Net mNet;                      ///< Classification network
+    std::vector<std::string> mClassNames;   ///< Labels of the classifier classes
+    std::vector<int32_t> mDetectorClasses;  ///< Detector classes that are classified, all if empty
+    int32_t mInputSize;                     ///< Square network input
+    double mScale;                          ///< Pixel scale of the blob
+    cv::Scalar mMean;                       ///< Mean subtracted before scaling
+    bool mSwapRB;                           ///< Network expects RGB
+    bool mSoftmax;                          ///< Network outputs logits
+    int32_t mBatchSize;                     ///< Crops per forward, extra boxes are left unclassified
+
+    cv::Mat mMap1, mMap2;                   ///< Undistorted to raw pixel maps (CV_32FC1)
+    cv::Mat mEmptyCrop;                     ///< Pads the batch
+    std::vector<cv::Mat> mCrops;            ///< Crop buffers, kept between frames
+    cv::Mat mCropMap1, mCropMap2;           ///< Maps of one crop
+};
+} // namespace Xycar
+
+#endif // CROP_CLASSIFIER_HPP_
@@ -0,0 +1,138 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file DebugRing.hpp
+ * @brief POSIX shared-memory ring of annotated frames and results for out-of-process debug viewers
+ * @version 1.0
+ * @date 2024-02-15
+ */
+
+#ifndef DEBUG_RING_HPP_
+#define DEBUG_RING_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+static constexpr uint32_t kDebugRingMaxBoxes = 32; ///< Boxes stored per frame
+
+/**
+ * @brief Where the distance of a detection comes from
+ */
+enum class RangeSource : int32_t
+{
+    NONE,         ///< No estimate, distance is negative
+    LIDAR,        ///< Closest lidar point associated with the box
+    GROUND_PLANE, ///< Bottom edge of the box intersected with the ground, used when no lidar point falls inside the box
+};
+
+/**
+ * @brief One detection as seen by the viewer
+ */
+struct DebugBox
+{
+    int32_t x, y, width, height; ///< Bounding box in the undistorted image
+    int32_t classId;             ///< Class index into the label file
+    float confidence;            ///< Detector confidence
+    uint32_t numPoints;          ///< Lidar points associated with the box
+    float distance;              ///< Distance of the object in VCS (m), negative if none
+    RangeSource rangeSource;     ///< Estimator of distance
+};
+
+/**
+ * @brief Per-frame results stored next to the annotated frame
+ */
+struct DebugResult
+{
+    uint64_t frameId;                      ///< Increasing frame counter of the node
+    uint64_t stamp;                        ///< Capture time in nanoseconds
+    uint32_t numBoxes;                     ///< Valid entries of boxes
+    DebugBox boxes[kDebugRingMaxBoxes];    ///< Detections of the frame
+};
+
+/**
+ * @brief Layout shared by the node and the viewers. Slots directly follow the header
+ *
+ * Each slot is a seqlock: the writer makes the sequence odd, copies, then makes it even again.
+ * A reader copies the slot and only accepts the copy if the sequence was even and unchanged.
+ */
+struct DebugRingHeader
+{
+    uint32_t magic;                          ///< kDebugRingMagic once initialized
+    uint32_t numSlots;                       ///< Number of slots
+    uint32_t width, height;                  ///< Frame size (CV_8UC3)
+    uint64_t slotSize;                       ///< Bytes per slot, including the slot header
+    std::atomic<uint64_t> writeCount;        ///< Frames written so far, slot = (writeCount - 1) % numSlots
+    std::atomic<int64_t> viewerHeartbeat;    ///< steady_clock time (ns) of the last viewer read
+};
+
+struct DebugRingSlot
+{
+    std::atomic<uint64_t> sequence; ///< Seqlock counter, odd while the writer copies
+    DebugResult result;             ///< Results of the frame
+    // followed by width * height * 3 bytes of BGR pixels
+};
+
+/**
+ * @brief Shared memory mapping used by both sides of the ring
+ */
+class DebugRing final
+{
+public:
+    using Ptr = DebugRing*; ///< Pointer type of this class
+
+    static constexpr uint32_t kDebugRingMagic = 0x58594442; ///< "XYDB"
+    static constexpr int64_t kViewerTimeoutNs = 1000000000; ///< A viewer counts as attached for 1 s after its last read
+
+    /**
+     * @brief Create (writer) the shared memory segment
+     *
+     * @param[in] name POSIX shared memory name, e.g. "/xycar_debug"
+     * @param[in] numSlots Number of frames kept in the ring
+     * @param[in] width Frame width
+     * @param[in] height Frame height
+     */
+    DebugRing(const std::string& name, uint32_t numSlots, uint32_t width, uint32_t height);
+
+    /**
+     * @brief Attach (viewer) to an existing segment
+     */
+    DebugRing(const std::string& name);
+    ~DebugRing();
+    DebugRing(const DebugRing&) = delete;
+    DebugRing& operator=(const DebugRing&) = delete;
+
+    bool isOpen() const { return mHeader != nullptr; }
+
+    /**
+     * @brief Publish a frame. Never blocks, and does nothing unless a viewer read recently
+     *
+     * @return true if the frame was copied into the ring
+     */
+    bool write(const cv::Mat& frame, const DebugResult& result);
+
+    /**
+     * @brief Copy the newest consistent frame
+     *
+     * @param[out] frame Copy of the annotated frame
+     * @param[out] result Copy of the results
+     * @return false if nothing was written yet or the writer kept overwriting the slot
+     */
+    bool readLatest(cv::Mat& frame, DebugResult& result);
+
+private:
+    DebugRingSlot* getSlot(uint64_t index) const;
+    static int64_t now();
+
+    std::string mName;                  ///< Shared memory name
+    bool mOwner;                        ///< Writer side unlinks the segment on destruction
+    size_t mMappedSize = 0;             ///< Size of the mapping
+    DebugRingHeader* mHeader = nullptr; ///< Start of the mapping
+};
+} // namespace Xycar
+
+#endif // DEBUG_RING_HPP_
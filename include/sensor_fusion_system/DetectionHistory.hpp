@@ -0,0 +1,64 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file DetectionHistory.hpp
+ * @brief Bounded history of per-frame detections, so a scan can be fused with the frame closest in time
+ * @version 1.0
+ * @date 2024-02-27
+ */
+
+#ifndef DETECTION_HISTORY_HPP_
+#define DETECTION_HISTORY_HPP_
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "sensor_fusion_system/CameraDetector.hpp"
+
+namespace Xycar {
+/**
+ * @brief Detections of one camera frame
+ */
+struct DetectionFrame
+{
+    uint64_t stamp = 0;                ///< Capture time of the frame in nanoseconds
+    std::vector<Detection> detections; ///< Detections of the frame
+};
+
+/**
+ * @brief Ring of the detections of the last frames
+ *
+ * The camera side pushes every frame, the lidar side looks up the frame closest to its scan. Both only
+ * hold the lock to copy a few boxes, neither waits for the other sensor. Slots keep their buffers, so
+ * no allocation happens once the number of boxes per frame is stable.
+ */
+class DetectionHistory final
+{
+public:
+    using Ptr = DetectionHistory*; ///< Pointer type of this class
+
+    /**
+     * @param[in] capacity Frames kept, the oldest is overwritten, at least one
+     */
+    DetectionHistory(uint32_t capacity);
+
+    void push(uint64_t stamp, const std::vector<Detection>& detections);
+
+    /**
+     * @brief Copy the frame whose stamp is closest to a time
+     *
+     * @return false if no frame was pushed yet
+     */
+    bool getClosest(uint64_t stamp, DetectionFrame& frame) const;
+
+private:
+    mutable std::mutex mMutex;          ///< Guards the ring
+    std::vector<DetectionFrame> mFrames; ///< Ring of frames
+    size_t mNext = 0;                   ///< Slot of the next push
+    size_t mSize = 0;                   ///< Valid slots
+};
+} // namespace Xycar
+
+#endif // DETECTION_HISTORY_HPP_
@@ -0,0 +1,44 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file EgoMotion.hpp
+ * @brief Planar motion of the car between two stamps, to move static points seen at one into the VCS of the other
+ * @version 1.0
+ * @date 2024-03-01
+ */
+
+#ifndef EGO_MOTION_HPP_
+#define EGO_MOTION_HPP_
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+/**
+ * @brief Displacement and rotation of the VCS (x forward, y left) from a start to an end time
+ */
+template <typename PREC>
+struct EgoMotion
+{
+    PREC dx = 0;  ///< Forward displacement in the start VCS (m)
+    PREC dy = 0;  ///< Left displacement in the start VCS (m)
+    PREC yaw = 0; ///< Rotation, counterclockwise positive (rad)
+
+    /**
+     * @brief Bicycle model at constant speed and wheel angle
+     *
+     * @param[in] speed Speed (m/s), negative when reversing
+     * @param[in] wheelAngle Front wheel angle, left positive (rad)
+     * @param[in] wheelbase Wheelbase (m)
+     * @param[in] dt End minus start time (s), negative moves backwards in time
+     */
+    static EgoMotion fromCommand(PREC speed, PREC wheelAngle, PREC wheelbase, PREC dt);
+
+    /**
+     * @brief Where a static point seen in the start VCS is in the end VCS
+     */
+    cv::Point_<PREC> apply(PREC x, PREC y) const;
+};
+} // namespace Xycar
+
+#endif // EGO_MOTION_HPP_
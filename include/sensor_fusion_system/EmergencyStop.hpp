@@ -0,0 +1,98 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file EmergencyStop.hpp
+ * @brief Corridor check on raw scan ranges, run inside the lidar callback before any fusion
+ * @version 1.0
+ * @date 2024-02-24
+ */
+
+#ifndef EMERGENCY_STOP_HPP_
+#define EMERGENCY_STOP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Xycar {
+/**
+ * @brief Stops the car when enough returns fall into the corridor it will sweep before it can brake
+ *
+ * The corridor is the car width (plus margin) wide and as long as the stopping distance at the current
+ * speed: reaction distance, braking distance and a margin. Beam directions are precomputed once per scan
+ * geometry, a check is one pass over the front beams without allocation. Free of ROS so it can be driven
+ * with synthetic scans.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class EmergencyStop final
+{
+public:
+    using Ptr = EmergencyStop*; ///< Pointer type of this class
+
+    /**
+     * @param[in] forwardAngle Beam angle (rad) that points along the driving direction
+     * @param[in] halfWidth Half width (m) of the corridor
+     * @param[in] frontOffset Distance (m) from the lidar to the front bumper
+     * @param[in] margin Distance (m) kept to the obstacle after braking
+     * @param[in] reactionTime Time (s) from the scan to the brakes acting
+     * @param[in] deceleration Braking deceleration (m/s^2)
+     * @param[in] minPoints Returns inside the corridor needed to stop, rejects single noisy beams
+     * @param[in] clearScans Consecutive clear scans needed to release the stop
+     */
+    EmergencyStop(PREC forwardAngle, PREC halfWidth, PREC frontOffset, PREC margin, PREC reactionTime, PREC deceleration,
+                  uint32_t minPoints, uint32_t clearScans)
+        : mForwardAngle(forwardAngle), mHalfWidth(halfWidth), mFrontOffset(frontOffset), mMargin(margin), mReactionTime(reactionTime),
+          mDeceleration(deceleration), mMinPoints(minPoints), mClearScans(clearScans)
+    {
+    }
+
+    /**
+     * @brief Precompute the beam directions. Cheap to call every scan, only recomputes when the geometry changes
+     *
+     * @param[in] rangeMin Returns at or below are invalid (0 is "no return" for many lidars)
+     */
+    void setScanGeometry(PREC angleMin, PREC angleIncrement, uint32_t numBeams, PREC rangeMin);
+
+    /**
+     * @brief Check one scan
+     *
+     * @param[in] ranges Raw ranges ordered by beam index, non finite returns are ignored
+     * @param[in] speed Speed (m/s) the car drives, or resumes with, after this scan
+     * @return true while stopped: set by a violation, released after clearScans clear scans
+     */
+    bool update(const float* ranges, size_t count, PREC speed);
+
+    bool isStopped() const { return mStopped; }
+
+    /**
+     * @brief Length (m) of the corridor in front of the bumper at a speed
+     */
+    PREC getStoppingDistance(PREC speed) const { return speed * mReactionTime + speed * speed / (2 * mDeceleration) + mMargin; }
+
+private:
+    const PREC mForwardAngle;  ///< Beam angle of the driving direction
+    const PREC mHalfWidth;     ///< Half width of the corridor
+    const PREC mFrontOffset;   ///< Lidar to front bumper
+    const PREC mMargin;        ///< Distance kept after braking
+    const PREC mReactionTime;  ///< Scan to braking delay
+    const PREC mDeceleration;  ///< Braking deceleration
+    const uint32_t mMinPoints; ///< Returns needed to stop
+    const uint32_t mClearScans; ///< Clear scans needed to release
+
+    PREC mAngleMin = 0;                ///< Geometry the beams were computed for
+    PREC mAngleIncrement = 0;
+    uint32_t mNumBeams = 0;
+    PREC mRangeMin = 0;                ///< Smallest valid return
+    std::vector<uint32_t> mBeams;      ///< Beams pointing forward
+    std::vector<PREC> mForward;        ///< Forward component of each beam direction
+    std::vector<PREC> mLateral;        ///< Lateral component of each beam direction
+
+    bool mStopped = false;             ///< Stop is active
+    uint32_t mClearCount = 0;          ///< Consecutive clear scans while stopped
+};
+} // namespace Xycar
+
+#endif // EMERGENCY_STOP_HPP_
@@ -0,0 +1,79 @@
+#ifndef EXPLICIT_MPC_CONTROLLER_HPP_
+#define EXPLICIT_MPC_CONTROLLER_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sensor_fusion_system/SteeringController.hpp"
+
+namespace Xycar {
+/**
+ * @brief Explicit MPC steering: the first move of a linear MPC, precomputed offline over a state grid
+ *
+ * The table is produced by sensor_fusion_system_mpc_table for the lateral error / heading error model
+ * at a few speeds. At runtime the state is estimated from the lane error and its change, and the
+ * steering is a trilinear interpolation (speed, lateral error, heading error) of the table.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class ExplicitMPCController final : public SteeringController<PREC>
+{
+public:
+    using Ptr = ExplicitMPCController*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Explicit MPC Controller object
+     *
+     * @param[in] tablePath Table written by the offline generator
+     * @param[in] metersPerPixel Lateral distance (m) of one pixel of lane error
+     * @param[in] speedToMps Conversion from the speed command to m/s
+     * @param[in] commandPerDegree Steering command units per degree of wheel angle
+     * @param[in] steeringLimit Largest |steering command|
+     * @param[in] controlPeriod Time (s) between two control steps
+     */
+    ExplicitMPCController(const std::string& tablePath, PREC metersPerPixel, PREC speedToMps, PREC commandPerDegree, int32_t steeringLimit,
+                          PREC controlPeriod);
+
+    /**
+     * @brief Compute and return the MPC steering command
+     *
+     * @param[in] errorFromMid Error between estimated position x and half of the image
+     * @return Steering angle command, within the steering limit
+     */
+    PREC getControlOutput(int32_t errorFromMid) override;
+
+    void setSpeed(PREC speed) override { mSpeed = speed * mSpeedToMps; }
+
+    /**
+     * @brief Whether the table was read and is consistent. If not, the controller always steers straight
+     */
+    bool isLoaded() const { return mLoaded; }
+
+private:
+    /**
+     * @brief Bilinear interpolation of one speed layer
+     */
+    PREC interpolate(int32_t speedIndex, PREC lateralPosition, PREC headingPosition) const;
+
+    const PREC mMetersPerPixel;   ///< Lateral distance of one pixel
+    const PREC mSpeedToMps;       ///< Speed command to m/s
+    const PREC mCommandPerRadian; ///< Steering command units per radian of wheel angle
+    const PREC mSteeringLimit;    ///< Largest |steering command|
+    const PREC mControlPeriod;    ///< Time between two control steps
+
+    std::vector<PREC> mSpeeds;    ///< Speeds (m/s) of the table layers, increasing
+    PREC mLateralMin, mLateralStep;   ///< Lateral error grid (m)
+    PREC mHeadingMin, mHeadingStep;   ///< Heading error grid (rad)
+    int32_t mLateralCount = 0;        ///< Lateral error nodes
+    int32_t mHeadingCount = 0;        ///< Heading error nodes
+    std::vector<PREC> mTable;         ///< Wheel angle (rad), [speed][lateral][heading]
+    bool mLoaded = false;             ///< Whether mTable comes from the table file
+
+    PREC mSpeed = 0;              ///< Current speed (m/s)
+    PREC mPreviousLateral = 0;    ///< Lateral error of the previous step
+    bool mHasPrevious = false;    ///< Whether mPreviousLateral is valid
+};
+} // namespace Xycar
+#endif // EXPLICIT_MPC_CONTROLLER_HPP_
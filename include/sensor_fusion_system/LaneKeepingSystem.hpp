@@ -1,17 +1,35 @@
 #ifndef LANE_KEEPING_SYSTEM_HPP_
 #define LANE_KEEPING_SYSTEM_HPP_
 
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/LaserScan.h>
 #include <xycar_msgs/xycar_motor.h>
 #include <yaml-cpp/yaml.h>
 #include <cmath>
+#include <stdexcept>
 #include <vector>
 
 #include "sensor_fusion_system/CameraDetector.hpp"
+#include "sensor_fusion_system/DebugRing.hpp"
+#include "sensor_fusion_system/DetectionHistory.hpp"
+#include "sensor_fusion_system/EgoMotion.hpp"
+#include "sensor_fusion_system/EmergencyStop.hpp"
+#include "sensor_fusion_system/ExplicitMPCController.hpp"
+#include "sensor_fusion_system/LatencyMonitor.hpp"
 #include "sensor_fusion_system/MovingAverageFilter.hpp"
+#include "sensor_fusion_system/ObjectTracker.hpp"
 #include "sensor_fusion_system/PIDController.hpp"
+#include "sensor_fusion_system/Pipeline.hpp"
+#include "sensor_fusion_system/PoolMatAllocator.hpp"
+#include "sensor_fusion_system/PurePursuitController.hpp"
+#include "sensor_fusion_system/Recorder.hpp"
+#include "sensor_fusion_system/ResultsLog.hpp"
+#include "sensor_fusion_system/ScanFilter.hpp"
+#include "sensor_fusion_system/ScanSegmenter.hpp"
+#include "sensor_fusion_system/StanleyController.hpp"
+#include "sensor_fusion_system/TaskPool.hpp"
 
 namespace Xycar {
 /**
@@ -26,14 +44,22 @@ class LaneKeepingSystem
 {
 public:
     using Ptr = LaneKeepingSystem*;                                     ///< Pointer type of this class
-    using ControllerPtr = typename PIDController<PREC>::Ptr;            ///< Pointer type of PIDController
+    using ControllerPtr = typename SteeringController<PREC>::Ptr;       ///< Pointer type of the steering controller
     using FilterPtr = typename MovingAverageFilter<PREC>::Ptr;          ///< Pointer type of MovingAverageFilter
     using DetectorPtr = typename CameraDetector<PREC>::Ptr;               ///< Pointer type of LaneDetecter(It's up to you)
+    using ScanFilterPtr = typename ScanFilterChain<PREC>::Ptr;          ///< Pointer type of ScanFilterChain
+    using TrackerPtr = typename ObjectTracker<PREC>::Ptr;               ///< Pointer type of ObjectTracker
+    using EmergencyStopPtr = typename EmergencyStop<PREC>::Ptr;         ///< Pointer type of EmergencyStop
+    using SegmenterPtr = typename ScanSegmenter<PREC>::Ptr;             ///< Pointer type of ScanSegmenter
 
     static constexpr int32_t kXycarSteeringAangleLimit = 50; ///< Xycar Steering Angle Limit
     static constexpr double kFrameRate = 33.0;               ///< Frame rate
+    static constexpr PREC kLatencySmoothing = 0.1;           ///< Weight of a new sample in the pipeline latency average
+    static constexpr double kIdleWait = 0.005;               ///< Longest wait (s) for a message before the pipeline runs anyway (timers)
     /**
      * @brief Construct a new Lane Keeping System object
+     *
+     * @throws std::runtime_error if PIPELINE does not describe a valid stage graph
      */
     LaneKeepingSystem();
 
@@ -66,21 +92,64 @@ private:
      * @brief publish the motor topic message
      *
      * @param[in] steeringAngle Angle to steer xycar actually
+     * @param[in] captureStamp Capture time (ns) of the frame the command is based on, sent in the message header
+     */
+    void drive(PREC steeringAngle, uint64_t captureStamp);
+
+    /**
+     * @brief Run the corridor check on a raw scan and publish a stop at once if it is violated
+     */
+    void checkEmergencyStop(const sensor_msgs::LaserScan& scan);
+
+    /**
+     * @brief Register the stage types that PIPELINE in the config file can use
+     */
+    void registerStages();
+
+    /**
+     * @brief Queue the results of the last processed frame and the new LATE_FUSE objects for the results log
+     */
+    void logResults();
+
+    /**
+     * @brief Position of a detection from its lidar points, or from the ground plane if it has none
+     *
+     * @param[in] detection Detection with associated points
+     * @param[in] lidarVcs VCS position of the lidar points at the scan time
+     * @param[in] motion Ego-motion from the scan to the target time, none keeps the points at the scan time
+     * @param[out] position Centroid of the points or ground contact in VCS
+     * @param[out] distance Closest point or ground contact distance (m)
+     * @return Estimator used, NONE if there is no position
      */
-    void drive(PREC steeringAngle);
+    RangeSource locate(const Detection& detection, const std::vector<cv::Point3f>& lidarVcs, const EgoMotion<PREC>& motion,
+                       cv::Point_<PREC>& position, float& distance) const;
+
     void imageCallback(const sensor_msgs::Image& message);
     void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan);
+    void motorCallback(const xycar_msgs::xycar_motor& message);
 
 private:
-    ControllerPtr mPID;                      ///< PID Class for Control
+    ControllerPtr mController = nullptr;     ///< Steering controller selected by CONTROLLER (PID, PURE_PURSUIT, STANLEY or MPC)
     FilterPtr mMovingAverage;                ///< Moving Average Filter Class for Noise filtering
     DetectorPtr mCameraDetector;
+    ScanFilterPtr mScanFilter;               ///< Range-domain noise filters applied to every scan
+    EmergencyStopPtr mEmergencyStop = nullptr; ///< Corridor check of the lidar callback, only created when enabled
+    SegmenterPtr mSegmenter;                 ///< Lidar-only obstacle segments of every scan
+    TrackerPtr mTracker;                     ///< Tracker of fused objects in VCS
+    Recorder::Ptr mRecorder = nullptr;       ///< Frame and scan recorder, only created when enabled
+    ResultsLog::Ptr mResultsLog = nullptr;   ///< Columnar log of the per-frame results, only created when enabled
+    DebugRing::Ptr mDebugRing = nullptr;     ///< Shared-memory ring read by the debug viewer, only created when enabled
+    TaskPool::Ptr mTaskPool;                 ///< Workers for per-object work, shared with the detector
+    Pipeline::Ptr mPipeline;                 ///< Stage graph run by the main loop
+    LatencyMonitor mLatencyMonitor;          ///< Capture to output latencies, reported with the stage rates
+    PoolMatAllocator::Ptr mMatAllocator = nullptr; ///< Default cv::Mat allocator when enabled, never deleted
 
     // ROS Variables
     ros::NodeHandle mNodeHandler;          ///< Node Hanlder for ROS. In this case Detector and Controler
     ros::Publisher mPublisher;             ///< Publisher to send message about
     ros::Subscriber mSubscriber;           ///< Subscriber to receive image
     ros::Subscriber mSubLidar;             ///< Subscriber to receive lidar
+    ros::Subscriber mSubMotor;             ///< Subscriber to the motor commands actually sent, by this node or any other
     std::string mPublishingTopicName;      ///< Topic name to publish
     std::string mSubscribedTopicName;      ///< Topic name to subscribe
     std::string mSubscribedLidarName;      ///< Topic name to subscribe lidar
@@ -89,6 +158,97 @@ private:
 
     // OpenCV Image processing Variables
     cv::Mat mFrame; ///< Image from camera. The raw image is converted into cv::Mat
+    uint64_t mFrameStamp = 0; ///< Capture time of mFrame in nanoseconds
+    uint64_t mFrameCount = 0; ///< Number of processed frames
+    uint64_t mLoggedFrameCount = 0; ///< mFrameCount when the results log was last written
+    uint64_t mLoggedScanStamp = 0;  ///< Stamp of the last LATE_FUSE objects written to the results log
+    bool mFrameDrawn = false;       ///< VISUALIZE drew a new debug frame, shown by run() on the main thread
+    std::vector<BoxRow> mLogBoxes;  ///< Box rows of the logged frame, kept to reuse the buffer
+    std::vector<ObjectRow> mLogObjects; ///< Object rows of the logged pass, kept to reuse the buffer
+
+    /**
+     * @brief Object positions of one fusion pass, the input of the tracker
+     */
+    struct FusedObjects
+    {
+        uint64_t stamp = 0;                             ///< Time the positions refer to in nanoseconds
+        std::vector<cv::Point_<PREC>> positions;        ///< Object positions in VCS, lidar centroid or ground contact
+        std::vector<int32_t> classIds;                  ///< Class of each position
+        std::vector<RangeSource> sources;               ///< Range estimator of each position
+
+        void clear()
+        {
+            positions.clear();
+            classIds.clear();
+            sources.clear();
+        }
+    };
+
+    /**
+     * @brief Queue the object positions of one fusion pass for the results log
+     */
+    void logObjects(const FusedObjects& objects, FusionPass pass);
+
+    /**
+     * @brief Data handed between the pipeline stages of one iteration
+     */
+    struct FrameData
+    {
+        // camera side, renewed once per frame
+        cv::Mat frame;                                  ///< Camera frame taken by INGEST_IMAGE
+        uint64_t stamp = 0;                             ///< Capture time of frame in nanoseconds
+
+        // lidar side, renewed once per scan
+        uint64_t scanStamp = 0;                         ///< Capture time of the scan in nanoseconds
+        std::vector<cv::Point3f> objectPoints;          ///< Lidar points in the lidar object frame
+        std::vector<int> beamIndices;                   ///< Scan index of each object point
+        std::vector<float> ranges;                      ///< Range of each object point
+        std::vector<cv::Point2f> lidarImagePoints;      ///< Projected object points inside the image
+        std::vector<cv::Point3f> lidarVcs;              ///< VCS position of each object point at scanStamp
+        std::vector<float> scanRanges;                  ///< Filtered ranges of the whole scan
+        PREC scanAngleMin = 0;                          ///< Angle of the first beam
+        PREC scanAngleIncrement = 0;                    ///< Angle between beams
+
+        // fused
+        FusedObjects imageObjects;                      ///< FUSE, once per frame: the latest scan moved to the frame time
+        FusedObjects scanObjects;                       ///< LATE_FUSE, once per scan: the detections of the closest frame
+        std::vector<float> distances;                   ///< FUSE, distance of each detection of the frame, negative if none
+        std::vector<RangeSource> rangeSources;          ///< FUSE, range estimator of each detection of the frame
+        DebugResult result;                             ///< Per-frame results for the debug ring and the results log
+        float detectionLatency = 0;                     ///< Capture to the end of FUSE (ms)
+    };
+    FrameData mFrameData; ///< Written and read by the pipeline stages, ordered by their dependencies
+    uint32_t mPendingEvents = 0;        ///< Pipeline events of the messages received since the last run
+    uint64_t mScanStamp = 0;            ///< Capture time of the latest scan in nanoseconds
+    int64_t mCameraTimeOffset;          ///< Added to the camera header stamps (ns) to put them on the lidar clock
+    double mRateReportPeriod;           ///< Period (s) of the per-stage rate report, 0 disables it
+    ros::WallTime mLastRateReport;      ///< Time of the last rate report
+
+    // Ego-motion between a scan and the frame it is fused with
+    PREC mSteeringAngle = 0;            ///< Last steering command of drive()
+    PREC mCommandedAngle = 0;           ///< Steering of the last message on the motor topic
+    PREC mCommandedSpeed = 0;           ///< Speed of the last message on the motor topic, 0 until a command is seen
+    PREC mSpeedToMps;                   ///< Speed command to m/s
+    PREC mRadianPerCommand;             ///< Wheel angle (rad) per steering command unit
+    PREC mWheelbase;                    ///< Wheelbase (m)
+
+    // Latency channels of mLatencyMonitor
+    uint32_t mImageTransportLatency;    ///< Camera capture to image callback
+    uint32_t mScanTransportLatency;     ///< Lidar capture to scan callback
+    uint32_t mDetectionLatency;         ///< Camera capture to fused detections
+    uint32_t mStopLatency;              ///< Lidar capture to emergency stop publish
+
+    // Late binding of scans to the detections closest in time
+    DetectionHistory::Ptr mDetectionHistory; ///< Detections of the last frames
+    DetectionFrame mLateFrame;               ///< Frame paired with the current scan, kept to reuse its buffers
+    uint64_t mMaxPairingGap;                 ///< Largest frame to scan time difference (ns) that is still fused
+    bool mTrackScanObjects;                  ///< Tracker input is LATE_FUSE (TRACKER.INPUT SCAN) instead of FUSE
+
+    // Latency compensation
+    uint64_t mLastTrackedStamp = 0;          ///< Capture time of the last frame given to the tracker
+    PREC mPipelineLatency = 0;               ///< Smoothed capture to command latency (s)
+    PREC mActuatorDelay;                     ///< Time (s) between publishing a command and the car reacting
+    std::vector<Track<PREC>> mPredictedTracks; ///< Tracks propagated to the expected actuation time, input of speed/steering logic
 
     // Xycar Device variables
     PREC mXycarSpeed;                 ///< Current speed of xycar
@@ -98,7 +258,12 @@ private:
     PREC mAccelerationStep;           ///< How much would accelrate xycar depending on threshold
     PREC mDecelerationStep;           ///< How much would deaccelrate xycar depending on threshold
 
+    std::vector<float> mScanRanges;         ///< Filtered ranges of the latest scan
+    PREC mScanAngleMin = 0;                 ///< Angle of the first beam of the latest scan
+    PREC mScanAngleIncrement = 0;           ///< Angle between beams of the latest scan
     std::vector<cv::Point2f> mLidarCoord;   ///< Lidar front(0~180 degree) coordinates
+    std::vector<int> mLidarBeamIndices;     ///< Scan index of each point in mLidarCoord
+    std::vector<float> mLidarRanges;        ///< Measured range of each point in mLidarCoord
 
     // Debug Flag
     bool mDebugging; ///< Debugging or not
@@ -0,0 +1,73 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file LatencyMonitor.hpp
+ * @brief Distributions of sensor capture to output latencies, including transport and queueing
+ * @version 1.0
+ * @date 2024-02-26
+ */
+
+#ifndef LATENCY_MONITOR_HPP_
+#define LATENCY_MONITOR_HPP_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Xycar {
+/**
+ * @brief Latency distribution of one channel over the recent samples
+ */
+struct LatencyStatistics
+{
+    std::string name; ///< Channel name
+    uint64_t count;   ///< Samples so far
+    double median;    ///< 50th percentile (ms)
+    double p90;       ///< 90th percentile (ms)
+    double p99;       ///< 99th percentile (ms)
+    double max;       ///< Largest recent sample (ms)
+};
+
+/**
+ * @brief Collects latencies measured as (now - header stamp of the sensor message the output is based on)
+ *
+ * Unlike stage timers this includes the driver, ROS transport, the callback queue and the wait for the
+ * pipeline. Each channel keeps its last kWindow samples. Thread safe, stages may record concurrently.
+ */
+class LatencyMonitor final
+{
+public:
+    using Ptr = LatencyMonitor*; ///< Pointer type of this class
+
+    static constexpr uint32_t kWindow = 1024; ///< Recent samples kept per channel
+
+    /**
+     * @return Id of the channel for record()
+     */
+    uint32_t addChannel(const std::string& name);
+
+    /**
+     * @param[in] channel Id returned by addChannel
+     * @param[in] captureStamp Header stamp (ns) of the sensor message
+     * @param[in] now Time (ns) the output was produced, same clock as the stamp
+     */
+    void record(uint32_t channel, uint64_t captureStamp, uint64_t now);
+
+    std::vector<LatencyStatistics> getStatistics() const;
+
+private:
+    struct Channel
+    {
+        std::string name;             ///< Channel name
+        uint64_t count = 0;           ///< Samples so far
+        std::vector<int64_t> samples; ///< Ring of the last kWindow latencies (ns), signed in case the clocks disagree
+    };
+
+    mutable std::mutex mMutex;     ///< Guards mChannels
+    std::vector<Channel> mChannels; ///< Channels by id
+};
+} // namespace Xycar
+
+#endif // LATENCY_MONITOR_HPP_
@@ -0,0 +1,430 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file LockFreeQueue.hpp
+ * @brief Bounded lock-free queues for handing data from the node thread to background workers
+ * @version 1.0
+ * @date 2024-02-20
+ *
+ * Used where one thread streams values to another: the Recorder and ResultsLog workers. The pipeline
+ * stages do not use them. The ROS callbacks and Pipeline::run share the main thread, and the stages of
+ * one level only overlap inside a TaskPool::parallelFor, whose barrier already orders them around the
+ * shared FrameData, so a queue would only add a copy per stage. The remaining shared state is not
+ * first in, first out: DetectionHistory is searched by stamp and LatencyMonitor aggregates samples
+ * from several writers, so both stay behind their mutexes, which are uncontended at frame rate.
+ */
+
+#ifndef LOCK_FREE_QUEUE_HPP_
+#define LOCK_FREE_QUEUE_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace Xycar {
+static constexpr size_t kCacheLineSize = 64; ///< Padding unit between producer and consumer state
+
+/**
+ * @brief What push does when the queue is full
+ */
+enum class OverflowPolicy : uint8_t
+{
+    DROP_NEWEST = 0, ///< Reject the pushed value
+    DROP_OLDEST = 1, ///< Discard the oldest queued value to make room
+    BLOCK = 2,       ///< Wait until the consumer makes room
+};
+
+namespace detail {
+inline size_t roundUpToPowerOfTwo(size_t value)
+{
+    size_t power = 1;
+    while (power < value)
+        power <<= 1;
+    return power;
+}
+} // namespace detail
+
+/**
+ * @brief Single-producer single-consumer ring
+ *
+ * Head and tail live on separate cache lines (the alignment also pads the object to whole lines),
+ * and each side keeps a cached copy of the other index so it only touches the shared line when
+ * the ring looks full or empty. DROP_OLDEST
+ * would make the producer consume and is rejected at compile time, use MpscQueue for it.
+ *
+ * @tparam T Element type, default constructible and move assignable
+ * @tparam Policy Overflow policy, DROP_NEWEST or BLOCK
+ */
+template <typename T, OverflowPolicy Policy = OverflowPolicy::DROP_NEWEST>
+class SpscQueue final
+{
+    static_assert(Policy != OverflowPolicy::DROP_OLDEST, "SpscQueue cannot drop the oldest element, use MpscQueue");
+
+public:
+    using Ptr = SpscQueue*; ///< Pointer type of this class
+
+    /**
+     * @param[in] capacity Minimum number of elements, rounded up to a power of two
+     */
+    SpscQueue(size_t capacity) : mMask(detail::roundUpToPowerOfTwo(capacity) - 1), mBuffer(new T[mMask + 1]) {}
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Producer side
+     *
+     * @return false if the value was dropped
+     */
+    bool push(T value)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        while (tail - mCachedHead > mMask)
+        {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            if (tail - mCachedHead <= mMask)
+                break;
+            if (Policy == OverflowPolicy::DROP_NEWEST)
+            {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        mBuffer[tail & mMask] = std::move(value);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Consumer side
+     *
+     * @return false if the queue was empty
+     */
+    bool pop(T& value)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mCachedTail)
+        {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+            if (head == mCachedTail)
+                return false;
+        }
+        value = std::move(mBuffer[head & mMask]);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return mMask + 1; }
+    size_t size() const { return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire); }
+    uint64_t getDroppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    const size_t mMask;              ///< capacity - 1
+    std::unique_ptr<T[]> mBuffer;    ///< Ring storage
+
+    alignas(kCacheLineSize) std::atomic<size_t> mHead = {0}; ///< Next slot to pop, written by the consumer
+    size_t mCachedTail = 0;                                  ///< Consumer copy of mTail
+
+    alignas(kCacheLineSize) std::atomic<size_t> mTail = {0}; ///< Next slot to push, written by the producer
+    size_t mCachedHead = 0;                                  ///< Producer copy of mHead
+    std::atomic<uint64_t> mDropped = {0};                    ///< Values rejected by DROP_NEWEST
+};
+
+/**
+ * @brief Multi-producer queue with per-cell sequence numbers (Vyukov bounded queue)
+ *
+ * Producers claim a cell with a CAS on the tail and publish it through the cell sequence, so
+ * a slow producer never blocks the others. The consumer side is also CAS based, which lets a
+ * producer discard the oldest cell itself under DROP_OLDEST (and would allow several consumers).
+ *
+ * @tparam T Element type, default constructible and move assignable
+ * @tparam Policy Overflow policy
+ */
+template <typename T, OverflowPolicy Policy = OverflowPolicy::DROP_NEWEST>
+class MpscQueue final
+{
+public:
+    using Ptr = MpscQueue*; ///< Pointer type of this class
+
+    /**
+     * @param[in] capacity Minimum number of elements, rounded up to a power of two
+     */
+    MpscQueue(size_t capacity) : mMask(detail::roundUpToPowerOfTwo(capacity) - 1), mCells(new Cell[mMask + 1])
+    {
+        for (size_t i = 0; i <= mMask; ++i)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Producer side, safe from any number of threads
+     *
+     * @return false if the pushed value was dropped. DROP_OLDEST always succeeds
+     */
+    bool push(T value)
+    {
+        while (!tryPush(value))
+        {
+            if (Policy == OverflowPolicy::DROP_NEWEST)
+            {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (Policy == OverflowPolicy::DROP_OLDEST)
+            {
+                T discarded;
+                if (pop(discarded))
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+                std::this_thread::yield();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Consumer side
+     *
+     * @return false if the queue was empty
+     */
+    bool pop(T& value)
+    {
+        size_t position = mHead.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = mCells[position & mMask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0)
+            {
+                if (mHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + mMask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = mHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return mMask + 1; }
+    uint64_t getDroppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence; ///< position when free, position + 1 when filled
+        T value;                      ///< Payload
+    };
+
+    bool tryPush(T& value)
+    {
+        size_t position = mTail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = mCells[position & mMask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = mTail.load(std::memory_order_relaxed);
+        }
+    }
+
+    const size_t mMask;              ///< capacity - 1
+    std::unique_ptr<Cell[]> mCells;  ///< Ring storage
+
+    alignas(kCacheLineSize) std::atomic<size_t> mHead = {0};   ///< Next cell to pop
+    alignas(kCacheLineSize) std::atomic<size_t> mTail = {0};   ///< Next cell to push
+    alignas(kCacheLineSize) std::atomic<uint64_t> mDropped = {0}; ///< Values lost to the overflow policy
+};
+
+/**
+ * @brief Latest-value mailbox (triple buffer)
+ *
+ * The writer always has a private slot to fill and publishes it by swapping it with the shared
+ * middle slot. The reader swaps the middle slot into its own only when something new was
+ * published. Neither side ever waits, and the reader always sees the newest complete value.
+ *
+ * @tparam T Value type, default constructible and assignable
+ */
+template <typename T>
+class Mailbox final
+{
+public:
+    using Ptr = Mailbox*; ///< Pointer type of this class
+
+    Mailbox() = default;
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    /**
+     * @brief Writer side: slot to fill before publish()
+     */
+    T& writeBuffer() { return mSlots[mWriteIndex].value; }
+
+    /**
+     * @brief Writer side: make the filled slot the latest value
+     */
+    void publish() { mWriteIndex = mMiddle.exchange(mWriteIndex | kFresh, std::memory_order_acq_rel) & kIndexMask; }
+
+    /**
+     * @brief Writer side: copy a value in and publish it
+     */
+    void write(const T& value)
+    {
+        writeBuffer() = value;
+        publish();
+    }
+
+    /**
+     * @brief Reader side: take the latest value if a new one was published
+     *
+     * @return true if readBuffer() changed
+     */
+    bool update()
+    {
+        if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0)
+            return false;
+        mReadIndex = mMiddle.exchange(mReadIndex, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    /**
+     * @brief Reader side: latest value taken by update()
+     */
+    const T& readBuffer() const { return mSlots[mReadIndex].value; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3; ///< Slot index bits of mMiddle
+    static constexpr uint8_t kFresh = 0x4;     ///< Set while the middle slot has not been read
+
+    struct alignas(kCacheLineSize) Slot
+    {
+        T value; ///< Payload
+    };
+
+    Slot mSlots[3];                                              ///< Writer, middle and reader slots
+    alignas(kCacheLineSize) std::atomic<uint8_t> mMiddle = {1};  ///< Shared slot index and fresh flag
+    alignas(kCacheLineSize) uint8_t mWriteIndex = 0;             ///< Writer slot
+    alignas(kCacheLineSize) uint8_t mReadIndex = 2;              ///< Reader slot
+};
+/**
+ * @brief Parks the consumer thread of a queue while it is empty (eventcount)
+ *
+ * Producers only look at an atomic flag after their push and take the mutex only when the consumer
+ * is actually parked, so a busy queue costs them nothing but the push. The consumer announces itself
+ * with prepareWait(), checks the queue once more, and then either cancelWait()s or commitWait()s.
+ * The flag store and the producer's push are both followed by a full fence, so either the consumer
+ * sees the pushed value in its last check or the producer sees the flag and wakes it.
+ *
+ * Consumer loop:
+ * @code
+ * if (!queue.pop(value)) {
+ *     signal.prepareWait();
+ *     if (!queue.pop(value)) { signal.commitWait(); continue; }
+ *     signal.cancelWait();
+ * }
+ * @endcode
+ */
+class WorkerSignal final
+{
+public:
+    using Ptr = WorkerSignal*; ///< Pointer type of this class
+
+    WorkerSignal() = default;
+    WorkerSignal(const WorkerSignal&) = delete;
+    WorkerSignal& operator=(const WorkerSignal&) = delete;
+
+    /**
+     * @brief Producer side, after a push: wake the consumer if it is parked
+     */
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!mSleeping.load(std::memory_order_relaxed))
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSignaled = true;
+        }
+        mCondition.notify_one();
+    }
+
+    /**
+     * @brief Any thread: stop the consumer, commitWait() returns and isRunning() turns false
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRunning = false;
+        }
+        mCondition.notify_one();
+    }
+
+    /**
+     * @brief Consumer side: false once stop() was called, the queue then only needs draining
+     */
+    bool isRunning()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mRunning;
+    }
+
+    /**
+     * @brief Consumer side: announce parking, the queue must be checked again before commitWait()
+     */
+    void prepareWait()
+    {
+        mSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief Consumer side: the last check found something, do not park
+     */
+    void cancelWait() { mSleeping.store(false, std::memory_order_relaxed); }
+
+    /**
+     * @brief Consumer side: park until a producer notifies or stop() is called
+     */
+    void commitWait()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return mSignaled || !mRunning; });
+        mSignaled = false;
+        mSleeping.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> mSleeping = {false}; ///< Set by the consumer between prepareWait and the wakeup
+    std::mutex mMutex;                     ///< Guards mSignaled and mRunning
+    std::condition_variable mCondition;    ///< Parks the consumer
+    bool mSignaled = false;                ///< A producer woke the consumer
+    bool mRunning = true;                  ///< Cleared by stop()
+};
+} // namespace Xycar
+
+#endif // LOCK_FREE_QUEUE_HPP_
@@ -0,0 +1,87 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ObjectTracker.hpp
+ * @brief Constant velocity tracker of fused objects in VCS, with prediction to an arbitrary time
+ * @version 1.0
+ * @date 2024-02-16
+ */
+
+#ifndef OBJECT_TRACKER_HPP_
+#define OBJECT_TRACKER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+/**
+ * @brief Tracked object in VCS (x forward, y left)
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+struct Track
+{
+    uint32_t id;                ///< Unique id of the track
+    int32_t classId;            ///< Class of the last associated detection
+    cv::Point_<PREC> position;  ///< Position (m) at stamp
+    cv::Point_<PREC> velocity;  ///< Velocity (m/s) relative to the car
+    uint64_t stamp;             ///< Time of position in nanoseconds
+    uint32_t hits;              ///< Number of associated measurements
+};
+
+/**
+ * @brief Alpha-beta tracker with greedy nearest neighbour association
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class ObjectTracker final
+{
+public:
+    using Ptr = ObjectTracker*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Object Tracker object
+     *
+     * @param[in] gateDistance Max distance (m) between a predicted track and a measurement to associate them
+     * @param[in] alpha Position correction gain
+     * @param[in] beta Velocity correction gain
+     * @param[in] maxAge Time (s) without measurement after which a track is dropped
+     */
+    ObjectTracker(PREC gateDistance, PREC alpha, PREC beta, PREC maxAge)
+        : mGateDistance(gateDistance), mAlpha(alpha), mBeta(beta), mMaxAgeNs(static_cast<uint64_t>(maxAge * 1e9))
+    {
+    }
+
+    /**
+     * @brief Associate measurements of one frame with the tracks and correct them
+     *
+     * @param[in] measurements Object positions in VCS
+     * @param[in] classIds Class of each measurement
+     * @param[in] stamp Capture time of the measurements in nanoseconds
+     */
+    void update(const std::vector<cv::Point_<PREC>>& measurements, const std::vector<int32_t>& classIds, uint64_t stamp);
+
+    /**
+     * @brief Propagate every track with its velocity to a time
+     *
+     * @param[in] stamp Target time in nanoseconds
+     * @return Tracks as they are expected to be at stamp
+     */
+    std::vector<Track<PREC>> predict(uint64_t stamp) const;
+
+    const std::vector<Track<PREC>>& getTracks() const { return mTracks; }
+
+private:
+    const PREC mGateDistance;          ///< Association gate (m)
+    const PREC mAlpha;                 ///< Position correction gain
+    const PREC mBeta;                  ///< Velocity correction gain
+    const uint64_t mMaxAgeNs;          ///< Track lifetime without measurement
+    uint32_t mNextId = 0;              ///< Id of the next created track
+    std::vector<Track<PREC>> mTracks;  ///< Live tracks
+};
+} // namespace Xycar
+
+#endif // OBJECT_TRACKER_HPP_
@@ -2,6 +2,9 @@
 #define PID_CONTROLLER_HPP_
 
 #include <cstdint>
+#include <vector>
+
+#include "sensor_fusion_system/SteeringController.hpp"
 
 namespace Xycar {
 /**
@@ -9,11 +12,23 @@ namespace Xycar {
  * @tparam PREC Precision of data
  */
 template <typename PREC>
-class PIDController
+class PIDController : public SteeringController<PREC>
 {
 public:
     using Ptr = PIDController*; ///< Pointer type of this class
 
+    static constexpr int32_t kScheduleSize = 256; ///< Number of nodes of the dense gain schedule
+
+    /**
+     * @brief Gains at one speed of the schedule
+     */
+    struct Gains
+    {
+        PREC proportional; ///< Proportional control gain
+        PREC integral;     ///< Integral control gain
+        PREC differential; ///< Differential control gain
+    };
+
     /**
      * @brief Construct a new PID object
      *
@@ -21,7 +36,21 @@ public:
      * @param[in] iGain Integral control gain to remove error of steady-state
      * @param[in] dGain Differential control gain to relieve overshoot and improve stability
      */
-    PIDController(PREC pGain, PREC iGain, PREC dGain) : mProportionalGain(pGain), mIntegralGain(iGain), mDifferentialGain(dGain) {}
+    PIDController(PREC pGain, PREC iGain, PREC dGain) : PIDController({0}, {{pGain, iGain, dGain}}) {}
+
+    /**
+     * @brief Construct a new PID object with gains scheduled on speed
+     *
+     * @param[in] speeds Speed commands of the schedule entries, strictly increasing
+     * @param[in] gains Gains at each speed, linearly interpolated in between and held beyond the ends.
+     *                  An invalid schedule is reported on std::cerr and replaced by zero gains
+     */
+    PIDController(const std::vector<PREC>& speeds, const std::vector<Gains>& gains);
+
+    /**
+     * @brief Whether a schedule is usable: at least one entry, one gain set per speed, finite strictly increasing speeds
+     */
+    static bool isValidSchedule(const std::vector<PREC>& speeds, const std::vector<Gains>& gains);
 
     /**
      * @brief Compute and return the PID Control Output
@@ -29,12 +58,18 @@ public:
      * @param[in] errorFromMid Error between estimated position x and half of the image
      * @return The result of PID controller
      */
-    PREC getControlOutput(int32_t errorFromMid);
+    PREC getControlOutput(int32_t errorFromMid) override;
+
+    /**
+     * @brief Select the scheduled gains for the current speed
+     */
+    void setSpeed(PREC speed) override;
 
 private:
-    const PREC mProportionalGain;      ///< Proportional control gain. The higher, the more powerful
-    const PREC mIntegralGain;          ///< Integral control gain to remove error of steady-state
-    const PREC mDifferentialGain;      ///< Differential control gain to relieve overshoot and improve stability
+    std::vector<Gains> mSchedule;      ///< Gains at kScheduleSize evenly spaced speeds
+    PREC mScheduleMin = 0;             ///< Speed of the first node
+    PREC mNodesPerSpeed = 0;           ///< Nodes per unit of speed
+    int32_t mScheduleIndex = 0;        ///< Node of the current speed
     PREC mProportionalGainError = 0.0; ///< Error to determine how much the proportional gain should be reflected
     PREC mIntegralGainError = 0.0;     ///< Error to determine how much the integral gain should be reflected
     PREC mDifferentialGainError = 0.0; ///< Error to determine how much the differential gain should be reflected
@@ -0,0 +1,135 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file Pipeline.hpp
+ * @brief Processing graph of named stages configured in YAML
+ * @version 1.0
+ * @date 2024-02-21
+ */
+
+#ifndef PIPELINE_HPP_
+#define PIPELINE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/TaskPool.hpp"
+
+namespace Xycar {
+/**
+ * @brief When a stage runs
+ */
+enum class StageTrigger : uint8_t
+{
+    DEPENDENCY = 0, ///< Whenever a dependency produced new output, every iteration for stages without dependencies
+    IMAGE = 1,      ///< Once per new camera frame
+    SCAN = 2,       ///< Once per new lidar scan
+    TIMER = 3,      ///< Every PERIOD seconds
+};
+
+/**
+ * @brief Achieved rate of one stage
+ */
+struct StageStatistics
+{
+    std::string name; ///< Stage name
+    double rate;      ///< Smoothed runs per second
+    double duration;  ///< Smoothed run time in milliseconds
+    uint64_t runs;    ///< Runs so far
+};
+
+/**
+ * @brief DAG of stages, run once per iteration of the node loop
+ *
+ * The node registers the stage types it provides. The configuration then instantiates stages
+ * by type and lists, for each one, the stages whose output it needs:
+ *
+ *   - {NAME: associate, TYPE: ASSOCIATE, AFTER: [detect, project], TRIGGER: IMAGE}
+ *
+ * Stages are grouped into levels by their longest dependency chain, and every level runs on
+ * the task pool, so independent branches execute concurrently. Each stage runs at the rate of
+ * its trigger, so lidar stages run once per scan and camera stages once per frame. A stage only
+ * runs while all its dependencies hold valid output, i.e. their last run returned true, and it
+ * reads the latest output even if the dependency did not run in the same iteration.
+ */
+class Pipeline final
+{
+public:
+    using Ptr = Pipeline*;                        ///< Pointer type of this class
+    using StageFunction = std::function<bool()>; ///< Stage body, false marks the output invalid
+
+    static constexpr uint32_t kImageEvent = 1 << 0; ///< A camera frame arrived since the last run
+    static constexpr uint32_t kScanEvent = 1 << 1;  ///< A lidar scan arrived since the last run
+    static constexpr double kRateSmoothing = 0.1;   ///< Weight of a new sample in the rate statistics
+
+    /**
+     * @param[in] taskPool Workers running the stages of one level concurrently
+     */
+    Pipeline(TaskPool::Ptr taskPool) : mTaskPool(taskPool) {}
+
+    /**
+     * @brief Make a stage type available to the configuration
+     */
+    void registerStage(const std::string& type, StageFunction function) { mRegistry[type] = std::move(function); }
+
+    /**
+     * @brief Build the graph from the PIPELINE list of the configuration
+     *
+     * @return false on an unknown type, unknown or duplicated name, or a cycle. The graph is empty then
+     */
+    bool configure(const YAML::Node& stages);
+
+    /**
+     * @brief Run the triggered stages, level by level
+     *
+     * @param[in] events kImageEvent / kScanEvent bits of the data that arrived since the last call
+     */
+    void run(uint32_t events);
+
+    /**
+     * @brief Whether the last run of a stage succeeded
+     */
+    bool succeeded(const std::string& name) const;
+
+    /**
+     * @brief Achieved rate and run time of every stage, in configuration order
+     */
+    std::vector<StageStatistics> getStatistics() const;
+
+    /**
+     * @brief Run time (ms) of every stage during the last run, in configuration order. Negative if it did not run
+     */
+    const std::vector<float>& getLastDurations() const { return mDurations; }
+
+private:
+    struct Stage
+    {
+        std::string name;                 ///< Instance name from the configuration
+        StageFunction function;           ///< Body from the registry
+        std::vector<size_t> dependencies; ///< Stages whose output is needed
+        StageTrigger trigger;             ///< When the stage runs
+        int64_t period;                   ///< TIMER period in nanoseconds
+        int64_t lastStart;                ///< steady_clock time of the last run, 0 before the first
+        double rate;                      ///< Smoothed runs per second
+        double duration;                  ///< Smoothed run time in milliseconds
+        uint64_t runs;                    ///< Runs so far
+    };
+
+    static int64_t now();
+
+    TaskPool::Ptr mTaskPool;                          ///< Runs the stages of a level
+    std::map<std::string, StageFunction> mRegistry;   ///< Stage types provided by the node
+    std::vector<Stage> mStages;                       ///< Configured stages
+    std::vector<std::vector<size_t>> mLevels;         ///< Stages grouped by dependency depth
+    std::vector<char> mSucceeded;                     ///< Result of the last run of each stage
+    std::vector<char> mRan;                           ///< Stages that ran in the current iteration
+    std::vector<float> mDurations;                    ///< Run time (ms) of the stages in the current iteration
+};
+} // namespace Xycar
+
+#endif // PIPELINE_HPP_
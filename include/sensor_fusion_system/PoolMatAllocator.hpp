@@ -0,0 +1,97 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file PoolMatAllocator.hpp
+ * @brief cv::MatAllocator that recycles buffers through size-class free lists
+ * @version 1.0
+ * @date 2024-02-22
+ */
+
+#ifndef POOL_MAT_ALLOCATOR_HPP_
+#define POOL_MAT_ALLOCATOR_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 3)
+using MatAccessFlags = cv::AccessFlag; ///< Access flag type of the MatAllocator interface
+#else
+using MatAccessFlags = int; ///< Access flag type of the MatAllocator interface
+#endif
+
+/**
+ * @brief Allocation counters of the pool
+ */
+struct PoolMatAllocatorStatistics
+{
+    uint64_t allocations; ///< Buffers handed out
+    uint64_t poolHits;    ///< Served from a free list
+    uint64_t largeAllocations; ///< Bigger than the largest size class, never pooled
+    uint64_t cachedBytes; ///< Bytes sitting in the free lists
+};
+
+/**
+ * @brief Pooled allocator for every cv::Mat of the process
+ *
+ * Requests are rounded up to a power of two size class of 64 bytes or more. Freed buffers go to the free
+ * list of their class and are handed out again, so the per-frame temporaries of blobFromImage,
+ * forward, minMaxLoc or projectPoints stop reaching malloc after the first frames. Buffers are
+ * 64 byte aligned; classes of 2 MiB and more can be aligned to huge pages and advised with
+ * MADV_HUGEPAGE to save TLB misses on the large blob and frame buffers.
+ *
+ * cv::Mat::setDefaultAllocator is process wide, so the pool serves every thread. It has to
+ * outlive every Mat it allocated and is therefore never destroyed once installed.
+ */
+class PoolMatAllocator final : public cv::MatAllocator
+{
+public:
+    using Ptr = PoolMatAllocator*; ///< Pointer type of this class
+
+    static constexpr size_t kAlignment = 64;                        ///< Buffer alignment (cache line)
+    static constexpr uint32_t kMinClassShift = 6;                   ///< Smallest class, 64 bytes
+    static constexpr uint32_t kMaxClassShift = 26;                  ///< Largest class, 64 MiB
+    static constexpr uint32_t kHugePageShift = 21;                  ///< 2 MiB huge pages
+
+    /**
+     * @param[in] hugePages Align classes of 2 MiB and more to huge pages and advise the kernel to back them with huge pages
+     * @param[in] maxCachedBytes Bytes kept in the free lists, freed buffers beyond it go back to the system
+     */
+    PoolMatAllocator(bool hugePages, size_t maxCachedBytes);
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, MatAccessFlags flags,
+                           cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, MatAccessFlags accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+    PoolMatAllocatorStatistics getStatistics() const;
+
+private:
+    /**
+     * @brief Free list of one size class
+     */
+    struct SizeClass
+    {
+        std::mutex mutex;           ///< Guards buffers
+        std::vector<void*> buffers; ///< Free buffers of this class
+    };
+
+    static uint32_t getClassShift(size_t size);
+    void* allocateBuffer(size_t size) const;
+
+    const bool mHugePages;       ///< Huge page backing for large classes
+    const size_t mMaxCachedBytes; ///< Cap of the free lists
+    mutable SizeClass mClasses[kMaxClassShift + 1]; ///< Free lists indexed by log2 of the class size
+    mutable std::atomic<uint64_t> mAllocations{0};      ///< Buffers handed out
+    mutable std::atomic<uint64_t> mPoolHits{0};         ///< Served from a free list
+    mutable std::atomic<uint64_t> mLargeAllocations{0}; ///< Not pooled
+    mutable std::atomic<uint64_t> mCachedBytes{0};      ///< Bytes in the free lists
+};
+} // namespace Xycar
+
+#endif // POOL_MAT_ALLOCATOR_HPP_
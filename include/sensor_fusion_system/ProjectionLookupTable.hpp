@@ -0,0 +1,110 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ProjectionLookupTable.hpp
+ * @brief Beam index x range bin -> image point lookup table for the planar lidar
+ * @version 1.0
+ * @date 2024-02-13
+ */
+
+#ifndef PROJECTION_LOOKUP_TABLE_HPP_
+#define PROJECTION_LOOKUP_TABLE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+/**
+ * @brief Precomputed projection of a fixed 2D lidar into the camera image
+ *
+ * For a fixed mounting, the pixel a beam lands on depends only on its index and range.
+ * The table stores the exact projection at evenly spaced range nodes for every beam and
+ * linearly interpolates between the two nodes around the requested range.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class ProjectionLookupTable final
+{
+public:
+    using Ptr = ProjectionLookupTable*; ///< Pointer type of this class
+    using ObjectPointFunction = std::function<cv::Point3f(PREC, PREC)>; ///< (angle, range) -> lidar object point
+
+    static inline const cv::Point2f kInvalidPoint = {-1.f, -1.f}; ///< Node that does not land in front of the camera
+
+    /**
+     * @brief Construct a new Projection Lookup Table object
+     *
+     * @param[in] rangeMin Smallest range covered by the table
+     * @param[in] rangeMax Largest range covered by the table
+     * @param[in] numRangeBins Number of range nodes per beam (at least 2)
+     */
+    ProjectionLookupTable(PREC rangeMin, PREC rangeMax, uint32_t numRangeBins);
+
+    /**
+     * @brief Project every (beam, range node) pair with the given calibration
+     *
+     * @param[in] angleMin Angle of the first beam
+     * @param[in] angleIncrement Angle between two consecutive beams
+     * @param[in] numBeams Number of beams in a scan
+     * @param[in] toObjectPoint Conversion from (angle, range) to the lidar object frame used by the extrinsics
+     * @param[in] rvec Lidar to camera rotation vector
+     * @param[in] tvec Lidar to camera translation vector
+     * @param[in] cameraMatrix Camera intrinsic matrix
+     * @param[in] distCoeffs Camera distortion coefficients
+     */
+    void build(PREC angleMin, PREC angleIncrement, uint32_t numBeams, const ObjectPointFunction& toObjectPoint,
+               const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs);
+
+    /**
+     * @brief Compare interpolated lookups against exact projection at the middle of every range bin
+     *
+     * @return Largest pixel distance between the table and cv::projectPoints
+     */
+    PREC validate(const ObjectPointFunction& toObjectPoint, const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix,
+                  const cv::Mat& distCoeffs) const;
+
+    /**
+     * @brief Interpolated image point of a beam at a range
+     *
+     * @param[in] beamIndex Index of the beam in the scan
+     * @param[in] range Measured range of the beam
+     * @param[out] imagePoint Interpolated image point
+     * @return false if the range is outside the table or the beam does not land in front of the camera
+     */
+    bool lookup(uint32_t beamIndex, PREC range, cv::Point2f& imagePoint) const;
+
+    /**
+     * @brief Check whether the table was built for this scan geometry
+     */
+    bool isBuiltFor(PREC angleMin, PREC angleIncrement, uint32_t numBeams) const;
+
+    /**
+     * @brief Check whether a range lies between the first and last range node
+     */
+    bool covers(PREC range) const { return range >= mRangeMin && range <= mRangeMax; }
+
+    void invalidate() { mBuilt = false; }
+    bool isBuilt() const { return mBuilt; }
+
+private:
+    PREC getNodeRange(uint32_t bin) const { return mRangeMin + static_cast<PREC>(bin) * mBinWidth; }
+
+    const PREC mRangeMin;          ///< Smallest range covered by the table
+    const PREC mRangeMax;          ///< Largest range covered by the table
+    const uint32_t mNumRangeBins;  ///< Number of range nodes per beam
+    const PREC mBinWidth;          ///< Distance between two range nodes
+    const PREC mInvBinWidth;       ///< Inverse of mBinWidth to avoid a division per lookup
+    PREC mAngleMin = 0.0;          ///< Angle of the first beam the table was built for
+    PREC mAngleIncrement = 0.0;    ///< Beam spacing the table was built for
+    uint32_t mNumBeams = 0;        ///< Beam count the table was built for
+    bool mBuilt = false;           ///< Whether mNodes matches the current calibration
+    std::vector<cv::Point2f> mNodes; ///< Image points, beam-major (beam * mNumRangeBins + bin)
+};
+} // namespace Xycar
+
+#endif // PROJECTION_LOOKUP_TABLE_HPP_
@@ -0,0 +1,50 @@
+#ifndef PURE_PURSUIT_CONTROLLER_HPP_
+#define PURE_PURSUIT_CONTROLLER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "sensor_fusion_system/SteeringController.hpp"
+
+namespace Xycar {
+/**
+ * @brief Pure pursuit steering on the lane output
+ *
+ * The lane error is an integer pixel offset at the lookahead row, so the whole chain
+ * (pixel -> lateral offset -> curvature -> wheel angle -> steering command) is precomputed
+ * for every possible error and a control step is a clamped table read.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class PurePursuitController final : public SteeringController<PREC>
+{
+public:
+    using Ptr = PurePursuitController*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Pure Pursuit Controller object
+     *
+     * @param[in] metersPerPixel Lateral distance (m) of one pixel at the lookahead row
+     * @param[in] lookahead Forward distance (m) of the lookahead row from the rear axle
+     * @param[in] wheelbase Wheelbase (m) of xycar
+     * @param[in] commandPerDegree Steering command units per degree of wheel angle
+     * @param[in] maxError Largest |errorFromMid| (pixel), usually half of the image width
+     * @param[in] steeringLimit Largest |steering command|
+     */
+    PurePursuitController(PREC metersPerPixel, PREC lookahead, PREC wheelbase, PREC commandPerDegree, int32_t maxError, int32_t steeringLimit);
+
+    /**
+     * @brief Compute and return the pure pursuit steering command
+     *
+     * @param[in] errorFromMid Error between estimated position x and half of the image
+     * @return Steering angle command, within the steering limit
+     */
+    PREC getControlOutput(int32_t errorFromMid) override;
+
+private:
+    const int32_t mMaxError;     ///< Largest tabulated |errorFromMid|
+    std::vector<PREC> mSteering; ///< Steering command for errorFromMid + mMaxError
+};
+} // namespace Xycar
+#endif // PURE_PURSUIT_CONTROLLER_HPP_
@@ -0,0 +1,144 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file Recorder.hpp
+ * @brief Compact recording of camera frames and lidar scans, and the matching reader for replay
+ * @version 1.0
+ * @date 2024-02-14
+ */
+
+#ifndef RECORDER_HPP_
+#define RECORDER_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+#include "sensor_fusion_system/LockFreeQueue.hpp"
+
+namespace Xycar {
+/**
+ * @brief Type of a record in the recording file
+ */
+enum class RecordType : uint8_t
+{
+    SCAN = 1,  ///< Quantized, delta coded lidar scan
+    FRAME = 2, ///< Encoded camera frame
+};
+
+/**
+ * @brief Codec used for camera frames
+ */
+enum class FrameCodec : uint8_t
+{
+    JPEG = 0, ///< High quality lossy, libjpeg-turbo through OpenCV
+    PNG = 1,  ///< Lossless, slower and bigger
+};
+
+/**
+ * @brief One record of the recording file, still encoded
+ */
+struct Record
+{
+    RecordType type;              ///< Scan or frame
+    uint64_t stamp;               ///< Capture time in nanoseconds
+    std::vector<uint8_t> payload; ///< Encoded data
+};
+
+/**
+ * @brief Writes frames and scans to a single file. Encoding and disk writes happen on a worker thread
+ *
+ * File layout: magic "XYREC1", then records of [type u8][stamp u64][payload size u32][payload].
+ * Scans are stored as 16 bit millimetre ranges, delta coded with zigzag varints.
+ * Frames are stored with the configured image codec.
+ */
+class Recorder final
+{
+public:
+    using Ptr = Recorder*; ///< Pointer type of this class
+
+    static constexpr float kRangeScale = 0.001f;       ///< Metres per quantization step
+    static constexpr uint16_t kInvalidRange = 0xFFFF;  ///< Quantized value of inf/NaN/out-of-range returns
+
+    /**
+     * @brief Construct a new Recorder object and start the worker thread
+     *
+     * @param[in] path Recording file path
+     * @param[in] codec Frame codec
+     * @param[in] jpegQuality JPEG quality (0-100) when codec is JPEG
+     * @param[in] queueSize Pending records kept before the oldest one is dropped, rounded up to a power of two
+     */
+    Recorder(const std::string& path, FrameCodec codec, int32_t jpegQuality, uint32_t queueSize);
+    ~Recorder();
+
+    /**
+     * @brief Queue a BGR frame for encoding. The frame is copied
+     */
+    void addFrame(uint64_t stamp, const cv::Mat& frame);
+
+    /**
+     * @brief Queue a scan for encoding. The ranges are copied
+     */
+    void addScan(uint64_t stamp, float angleMin, float angleIncrement, const std::vector<float>& ranges);
+
+    uint64_t getDroppedCount() const { return mQueue.getDroppedCount(); }
+
+    static void encodeScan(float angleMin, float angleIncrement, const std::vector<float>& ranges, std::vector<uint8_t>& payload);
+    static bool decodeScan(const std::vector<uint8_t>& payload, float& angleMin, float& angleIncrement, std::vector<float>& ranges);
+    static void encodeFrame(const cv::Mat& frame, FrameCodec codec, int32_t jpegQuality, std::vector<uint8_t>& payload);
+    static bool decodeFrame(const std::vector<uint8_t>& payload, cv::Mat& frame);
+
+private:
+    /**
+     * @brief Raw data waiting for the worker thread
+     */
+    struct Pending
+    {
+        RecordType type;
+        uint64_t stamp;
+        cv::Mat frame;
+        float angleMin;
+        float angleIncrement;
+        std::vector<float> ranges;
+    };
+
+    void work();
+    void write(const Record& record);
+
+    std::ofstream mFile;          ///< Recording file
+    const FrameCodec mCodec;      ///< Frame codec
+    const int32_t mJpegQuality;   ///< JPEG quality
+    MpscQueue<Pending, OverflowPolicy::DROP_OLDEST> mQueue; ///< Records waiting for the worker, filled by both callbacks
+    WorkerSignal mSignal;         ///< Parks the worker while the queue is empty
+    std::thread mWorker;          ///< Encoding and writing thread
+};
+
+/**
+ * @brief Sequential reader of a recording file
+ */
+class RecordReader final
+{
+public:
+    RecordReader(const std::string& path);
+
+    bool isOpen() const { return mValid; }
+
+    /**
+     * @brief Read the next record
+     *
+     * @return false at the end of the file or on a truncated record
+     */
+    bool next(Record& record);
+
+private:
+    std::ifstream mFile; ///< Recording file
+    bool mValid;         ///< Whether the file has a valid header
+};
+} // namespace Xycar
+
+#endif // RECORDER_HPP_
@@ -0,0 +1,259 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ResultsLog.hpp
+ * @brief Columnar, block compressed log of the per-frame results for offline analysis
+ * @version 1.0
+ * @date 2024-02-28
+ */
+
+#ifndef RESULTS_LOG_HPP_
+#define RESULTS_LOG_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sensor_fusion_system/LockFreeQueue.hpp"
+
+namespace Xycar {
+/**
+ * @brief Tables of the results log, one block holds rows of a single table
+ */
+enum class LogTable : uint8_t
+{
+    STAGE_NAMES = 0, ///< Newline separated stage names, indexed by StageRow::stage. Written once, uncompressed
+    FRAMES = 1,      ///< One FrameRow per processed frame
+    BOXES = 2,       ///< One BoxRow per detection
+    STAGES = 3,      ///< One StageRow per stage that ran in the iteration of a frame
+    OBJECTS = 4,     ///< One ObjectRow per fused object position, of both fusion passes
+};
+
+/**
+ * @brief Storage type of a column
+ */
+enum class ColumnType : uint8_t
+{
+    U8,
+    I32,
+    U32,
+    U64,
+    F32,
+};
+
+/**
+ * @brief One column of a table: name in the export, type, and where it lives in the row struct
+ */
+struct ColumnSchema
+{
+    const char* name;  ///< CSV header
+    ColumnType type;   ///< Storage type
+    size_t offset;     ///< offsetof the field in the row struct
+    size_t size;       ///< sizeof the field
+};
+
+/**
+ * @brief Results of one frame
+ */
+struct FrameRow
+{
+    uint64_t frameId;          ///< Increasing frame counter of the node
+    uint64_t stamp;            ///< Capture time of the frame in nanoseconds, on the lidar clock
+    uint64_t scanStamp;        ///< Capture time of the scan fused with the frame
+    float detectionLatency;    ///< Capture to fused detections (ms)
+    float iterationDuration;   ///< Sum of the stage run times of the iteration (ms)
+    uint32_t numBoxes;         ///< Detections of the frame
+    uint32_t numTracks;        ///< Live tracks after the frame
+    float steeringAngle;       ///< Last steering command
+    float speed;               ///< Last speed command
+    uint8_t emergencyStop;     ///< 1 while the emergency stop holds the car
+};
+
+/**
+ * @brief One detection of a frame
+ */
+struct BoxRow
+{
+    uint64_t frameId;     ///< Frame of the detection
+    int32_t classId;      ///< Detector class
+    float confidence;     ///< Detector confidence
+    int32_t x, y;         ///< Top left corner in the undistorted image
+    int32_t width, height; ///< Box size
+    uint32_t numPoints;   ///< Lidar points associated with the box
+    float distance;       ///< Distance in VCS (m), negative if none
+    uint8_t rangeSource;  ///< RangeSource of distance
+};
+
+/**
+ * @brief Fusion pass an object position comes from
+ */
+enum class FusionPass : uint8_t
+{
+    FRAME = 0, ///< FUSE: detections of a frame with the latest scan moved to the frame time
+    SCAN = 1,  ///< LATE_FUSE: a scan with the detections of the closest frame, at the scan time
+};
+
+/**
+ * @brief One fused object position, the tracker input
+ */
+struct ObjectRow
+{
+    uint64_t frameId;     ///< Last frame processed when the position was logged
+    uint64_t stamp;       ///< Time the position refers to in nanoseconds
+    uint8_t pass;         ///< FusionPass
+    int32_t classId;      ///< Detector class
+    float x, y;           ///< Position in VCS (m)
+    uint8_t rangeSource;  ///< RangeSource of the position
+};
+
+/**
+ * @brief Run time of one stage in the iteration of a frame
+ */
+struct StageRow
+{
+    uint64_t frameId;  ///< Frame of the iteration
+    uint32_t stage;    ///< Index into the stage names
+    float duration;    ///< Run time (ms)
+};
+
+/**
+ * @brief Column layout of a table, fixed by the code so the file only stores values
+ */
+struct TableSchema
+{
+    const ColumnSchema* columns; ///< Columns in storage order
+    size_t numColumns;           ///< Number of columns
+    size_t rowSize;              ///< Sum of the column sizes
+};
+
+/**
+ * @brief Schema of a table, numColumns is 0 for STAGE_NAMES and unknown tables
+ */
+TableSchema getTableSchema(LogTable table);
+
+/**
+ * @brief One block of the file, decompressed
+ */
+struct LogBlock
+{
+    LogTable table;            ///< Table of the rows
+    uint32_t rows;             ///< Number of rows
+    std::vector<uint8_t> data; ///< Column after column, each rows * column size bytes
+};
+
+/**
+ * @brief Appends per-frame results to a columnar file. Compression and disk writes happen on a worker thread
+ *
+ * File layout: magic "XYLOG1", then blocks of [table u8][rows u32][raw size u32][stored size u32][data].
+ * Rows are buffered per table until blockRows are collected, then stored column by column and compressed
+ * with zlib as one block, so a reader decompresses and scans a column without parsing rows.
+ */
+class ResultsLog final
+{
+public:
+    using Ptr = ResultsLog*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Results Log object and start the worker thread
+     *
+     * @param[in] path Log file path
+     * @param[in] stageNames Pipeline stage names, in the order of the stage durations
+     * @param[in] blockRows Rows per compressed block
+     * @param[in] compressionLevel zlib level, 1 (fastest) to 9 (smallest)
+     * @param[in] queueSize Pending frames kept before the oldest one is dropped, rounded up to a power of two
+     */
+    ResultsLog(const std::string& path, const std::vector<std::string>& stageNames, uint32_t blockRows, int32_t compressionLevel,
+               uint32_t queueSize);
+
+    /**
+     * @brief Stop the worker after it wrote every queued frame and the partial blocks
+     */
+    ~ResultsLog();
+
+    /**
+     * @brief Queue the results of one frame. Never blocks
+     *
+     * @param[in] frame Frame row
+     * @param[in] boxes Detections of the frame
+     * @param[in] stageDurations Run time (ms) of each stage in the iteration, negative if it did not run
+     */
+    void add(const FrameRow& frame, const std::vector<BoxRow>& boxes, const std::vector<float>& stageDurations);
+
+    /**
+     * @brief Queue fused object positions, of a frame or of a scan that arrived between frames. Never blocks
+     */
+    void add(const std::vector<ObjectRow>& objects);
+
+    uint64_t getDroppedCount() const { return mQueue.getDroppedCount(); }
+
+private:
+    /**
+     * @brief Rows of one frame waiting for the worker thread
+     */
+    struct Pending
+    {
+        bool hasFrame = false;
+        FrameRow frame = {};
+        std::vector<BoxRow> boxes;
+        std::vector<StageRow> stages;
+        std::vector<ObjectRow> objects;
+    };
+
+    /**
+     * @brief Rows of one table collected for the next block
+     */
+    struct TableBuffer
+    {
+        LogTable table;            ///< Table of the rows
+        std::vector<uint8_t> rows; ///< Row structs back to back
+        uint32_t numRows = 0;      ///< Rows collected
+    };
+
+    void work();
+    void append(TableBuffer& buffer, const void* row, size_t rowSize);
+    void flush(TableBuffer& buffer);
+    void writeBlock(LogTable table, uint32_t rows, const std::vector<uint8_t>& raw, const std::vector<uint8_t>& stored);
+
+    std::ofstream mFile;                 ///< Log file
+    const uint32_t mBlockRows;           ///< Rows per block
+    const int32_t mCompressionLevel;     ///< zlib level
+    MpscQueue<Pending, OverflowPolicy::DROP_OLDEST> mQueue; ///< Frames waiting for the worker
+    WorkerSignal mSignal;                ///< Parks the worker while the queue is empty
+    TableBuffer mFrames{LogTable::FRAMES};   ///< Worker side, frame rows
+    TableBuffer mBoxes{LogTable::BOXES};     ///< Worker side, box rows
+    TableBuffer mStages{LogTable::STAGES};   ///< Worker side, stage rows
+    TableBuffer mObjects{LogTable::OBJECTS}; ///< Worker side, object rows
+    std::vector<uint8_t> mColumns;       ///< Worker side, block being transposed
+    std::vector<uint8_t> mCompressed;    ///< Worker side, block being compressed
+    std::thread mWorker;                 ///< Compression and writing thread
+};
+
+/**
+ * @brief Sequential reader of a results log
+ */
+class ResultsLogReader final
+{
+public:
+    ResultsLogReader(const std::string& path);
+
+    bool isOpen() const { return mValid; }
+
+    /**
+     * @brief Read and decompress the next block
+     *
+     * @return false at the end of the file or on a truncated or corrupt block
+     */
+    bool next(LogBlock& block);
+
+private:
+    std::ifstream mFile;               ///< Log file
+    bool mValid;                       ///< Whether the file has a valid header
+    std::vector<uint8_t> mStored;      ///< Compressed data of the current block
+};
+} // namespace Xycar
+
+#endif // RESULTS_LOG_HPP_
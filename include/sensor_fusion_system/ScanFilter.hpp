@@ -0,0 +1,135 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ScanFilter.hpp
+ * @brief Range-domain noise filters for the planar lidar, applied in-process on every scan
+ * @version 1.0
+ * @date 2024-02-13
+ */
+
+#ifndef SCAN_FILTER_HPP_
+#define SCAN_FILTER_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+namespace Xycar {
+/**
+ * @brief Base class of a filter working on the contiguous range array of a scan
+ *
+ * Removed returns are set to NaN, the same convention as laser_filters.
+ * Filters keep their scratch buffers between scans so no allocation happens once the scan size is stable.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class ScanFilter
+{
+public:
+    using Ptr = ScanFilter*; ///< Pointer type of this class
+
+    virtual ~ScanFilter() = default;
+
+    /**
+     * @brief Filter the ranges in place
+     *
+     * @param[in,out] ranges Ranges of one scan ordered by beam index
+     * @param[in] angleIncrement Angle between two consecutive beams
+     */
+    virtual void apply(std::vector<float>& ranges, PREC angleIncrement) = 0;
+};
+
+/**
+ * @brief Windowed median. Windows 3 and 5 use branch-free min/max networks the compiler vectorizes
+ */
+template <typename PREC>
+class MedianScanFilter final : public ScanFilter<PREC>
+{
+public:
+    /**
+     * @param[in] window Odd window size in beams
+     */
+    MedianScanFilter(uint32_t window) : mHalfWindow(window / 2) {}
+    void apply(std::vector<float>& ranges, PREC angleIncrement) override;
+
+private:
+    const uint32_t mHalfWindow;  ///< Beams taken on each side of the filtered beam
+    std::vector<float> mScratch; ///< Copy of the unfiltered ranges
+    std::vector<float> mWindow;  ///< Window buffer for the generic (nth_element) path
+};
+
+/**
+ * @brief Removes returns that differ from both neighbours by more than a threshold
+ */
+template <typename PREC>
+class IsolatedPointScanFilter final : public ScanFilter<PREC>
+{
+public:
+    /**
+     * @param[in] threshold Range jump (m) to both neighbours that marks a return as isolated
+     */
+    IsolatedPointScanFilter(PREC threshold) : mThreshold(static_cast<float>(threshold)) {}
+    void apply(std::vector<float>& ranges, PREC angleIncrement) override;
+
+private:
+    const float mThreshold;      ///< Range jump threshold
+    std::vector<float> mScratch; ///< Copy of the unfiltered ranges
+};
+
+/**
+ * @brief Shadow (veiling) filter. Removes the farther return of two neighbours seen under a grazing angle
+ */
+template <typename PREC>
+class ShadowScanFilter final : public ScanFilter<PREC>
+{
+public:
+    /**
+     * @param[in] minAngle Smallest accepted angle (degree) between the beam and the surface
+     * @param[in] maxAngle Largest accepted angle (degree) between the beam and the surface
+     * @param[in] window Neighbours checked on each side
+     */
+    ShadowScanFilter(PREC minAngle, PREC maxAngle, uint32_t window);
+    void apply(std::vector<float>& ranges, PREC angleIncrement) override;
+
+private:
+    const float mTanMinAngle;     ///< tan(minAngle)
+    const float mTanMaxAngle;     ///< tan(maxAngle)
+    const uint32_t mWindow;       ///< Neighbours checked on each side
+    PREC mAngleIncrement = 0.0;   ///< Beam spacing mSin/mCos were computed for
+    std::vector<float> mSin;      ///< sin(k * angleIncrement) for k in [1, window]
+    std::vector<float> mCos;      ///< cos(k * angleIncrement) for k in [1, window]
+    std::vector<uint8_t> mRemove; ///< Beams to remove
+};
+
+/**
+ * @brief Ordered chain of scan filters built from the SCAN_FILTER list of the config file
+ */
+template <typename PREC>
+class ScanFilterChain final
+{
+public:
+    using Ptr = ScanFilterChain*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Scan Filter Chain object
+     *
+     * @param[in] config SCAN_FILTER sequence. Each entry has a TYPE (MEDIAN, ISOLATED_POINT, SHADOW) and its parameters
+     */
+    ScanFilterChain(const YAML::Node& config);
+    ~ScanFilterChain();
+
+    /**
+     * @brief Run every filter of the chain in order
+     */
+    void apply(std::vector<float>& ranges, PREC angleIncrement);
+
+    bool empty() const { return mFilters.empty(); }
+
+private:
+    std::vector<typename ScanFilter<PREC>::Ptr> mFilters; ///< Filters in application order
+};
+} // namespace Xycar
+
+#endif // SCAN_FILTER_HPP_
@@ -0,0 +1,126 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ScanSegmenter.hpp
+ * @brief Lidar-only obstacles: breakpoint segmentation of the ordered ranges and a line fit per segment
+ * @version 1.0
+ * @date 2024-02-25
+ */
+
+#ifndef SCAN_SEGMENTER_HPP_
+#define SCAN_SEGMENTER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+/**
+ * @brief Obstacle segment of one scan in VCS (x forward, y left)
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+struct ScanSegment
+{
+    cv::Point_<PREC> start;    ///< Fitted line at the first beam
+    cv::Point_<PREC> end;      ///< Fitted line at the last beam
+    cv::Point_<PREC> centroid; ///< Mean of the points
+    uint32_t firstBeam;        ///< Scan index of the first point
+    uint32_t lastBeam;         ///< Scan index of the last point, smaller than firstBeam if the segment wraps around
+    uint32_t numPoints;        ///< Valid returns in the segment
+    int32_t classId;           ///< Class of the camera detection attached to it, -1 if none
+    float confidence;          ///< Confidence of that detection
+};
+
+/**
+ * @brief Splits a scan into segments with the adaptive breakpoint detector and fits a line to each
+ *
+ * Consecutive returns belong to the same segment unless their distance exceeds
+ * r * sin(dphi) / sin(lambda - dphi) + 3 sigma (Borges and Aldon), i.e. the gap a surface seen under the
+ * incidence angle lambda would leave. One pass over the beams with running sums, no allocation once the
+ * scan size is stable. A full 360 degree scan starts at a breakpoint so objects across the first and
+ * last beam are not cut in two.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class ScanSegmenter final
+{
+public:
+    using Ptr = ScanSegmenter*; ///< Pointer type of this class
+
+    /**
+     * @param[in] lambda Smallest incidence angle (rad) of a surface that is still one segment
+     * @param[in] sigma Range noise (m)
+     * @param[in] minPoints Segments with fewer returns are dropped
+     * @param[in] maxRange Returns beyond are ignored
+     */
+    ScanSegmenter(PREC lambda, PREC sigma, uint32_t minPoints, PREC maxRange)
+        : mLambda(lambda), mSigma(sigma), mMinPoints(minPoints), mMaxRange(maxRange)
+    {
+    }
+
+    /**
+     * @brief Affine map from the scan plane (x = r cos, y = r sin) to VCS, as images of the origin and the unit axes
+     */
+    void setLidarToVCS(const cv::Point_<PREC>& origin, const cv::Point_<PREC>& xAxis, const cv::Point_<PREC>& yAxis);
+
+    /**
+     * @brief Segment one scan. Previous segments and labels are replaced
+     *
+     * @param[in] ranges Ranges ordered by beam index, non finite returns are skipped
+     */
+    void segment(const std::vector<float>& ranges, PREC angleMin, PREC angleIncrement);
+
+    /**
+     * @brief Attach a camera label to the segment that most of the given beams belong to
+     *
+     * A segment keeps the most confident label it was given since the last segment().
+     *
+     * @param[in] beams Scan indices of the lidar points inside a detection
+     * @return Index of the labelled segment, -1 if no beam belongs to a segment
+     */
+    int32_t label(const std::vector<int>& beams, int32_t classId, float confidence);
+
+    const std::vector<ScanSegment<PREC>>& getSegments() const { return mSegments; }
+
+private:
+    /**
+     * @brief Running sums of the points of the open segment
+     */
+    struct Accumulator
+    {
+        uint32_t firstBeam, lastBeam, count;
+        PREC sx, sy, sxx, syy, sxy;
+        cv::Point_<PREC> first, last;
+    };
+
+    void updateGeometry(PREC angleMin, PREC angleIncrement, uint32_t numBeams);
+    void close(const Accumulator& open);
+    cv::Point_<PREC> toVCS(const cv::Point_<PREC>& point) const { return mOrigin + mXAxis * point.x + mYAxis * point.y; }
+
+    const PREC mLambda;      ///< Breakpoint incidence angle
+    const PREC mSigma;       ///< Range noise
+    const uint32_t mMinPoints; ///< Smallest segment
+    const PREC mMaxRange;    ///< Farthest return used
+
+    cv::Point_<PREC> mOrigin = {0, 0}; ///< Scan plane to VCS
+    cv::Point_<PREC> mXAxis = {1, 0};
+    cv::Point_<PREC> mYAxis = {0, 1};
+
+    PREC mAngleMin = 0;            ///< Geometry the tables were computed for
+    PREC mAngleIncrement = 0;
+    uint32_t mNumBeams = 0;
+    bool mFullCircle = false;      ///< First and last beam are neighbours
+    PREC mAdjacentFactor = 0;      ///< sin(dphi) / sin(lambda - dphi) of neighbouring beams
+    std::vector<PREC> mCos, mSin;  ///< Beam directions
+
+    std::vector<ScanSegment<PREC>> mSegments; ///< Segments of the last scan
+    std::vector<int32_t> mBeamSegment;        ///< Segment of each beam, -1 if none
+    std::vector<uint32_t> mVotes;             ///< Scratch of label()
+};
+} // namespace Xycar
+
+#endif // SCAN_SEGMENTER_HPP_
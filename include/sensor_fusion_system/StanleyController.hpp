@@ -0,0 +1,63 @@
+#ifndef STANLEY_CONTROLLER_HPP_
+#define STANLEY_CONTROLLER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "sensor_fusion_system/SteeringController.hpp"
+
+namespace Xycar {
+/**
+ * @brief Stanley steering on the lane output
+ *
+ * The lane detector only provides a lateral offset, so the steering is the cross-track term
+ * atan(k * e / (v + v_soft)). atan is read from a table over the argument with linear interpolation,
+ * and the wheel angle -> command mapping is folded into the table, so a step costs one interpolation.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class StanleyController final : public SteeringController<PREC>
+{
+public:
+    using Ptr = StanleyController*; ///< Pointer type of this class
+
+    static constexpr int32_t kTableSize = 1024; ///< Number of atan nodes
+
+    /**
+     * @brief Construct a new Stanley Controller object
+     *
+     * @param[in] metersPerPixel Lateral distance (m) of one pixel at the front axle row
+     * @param[in] gain Cross-track gain k
+     * @param[in] softeningSpeed Speed (m/s) added to the current speed so the steering stays finite at standstill
+     * @param[in] speedToMps Conversion from the speed command to m/s
+     * @param[in] commandPerDegree Steering command units per degree of wheel angle
+     * @param[in] steeringLimit Largest |steering command|
+     */
+    StanleyController(PREC metersPerPixel, PREC gain, PREC softeningSpeed, PREC speedToMps, PREC commandPerDegree, int32_t steeringLimit);
+
+    /**
+     * @brief Compute and return the Stanley steering command
+     *
+     * @param[in] errorFromMid Error between estimated position x and half of the image
+     * @return Steering angle command, within the steering limit
+     */
+    PREC getControlOutput(int32_t errorFromMid) override;
+
+    /**
+     * @brief Update the gain per pixel for the current speed
+     */
+    void setSpeed(PREC speed) override;
+
+private:
+    const PREC mMetersPerPixel;   ///< Lateral distance of one pixel
+    const PREC mGain;             ///< Cross-track gain
+    const PREC mSofteningSpeed;   ///< Softening speed (m/s)
+    const PREC mSpeedToMps;       ///< Speed command to m/s
+    PREC mMaxArgument;            ///< atan argument at which the command reaches the steering limit
+    PREC mNodesPerArgument;       ///< Table nodes per unit of atan argument
+    PREC mArgumentPerPixel;       ///< k * metersPerPixel / (v + v_soft), updated by setSpeed
+    std::vector<PREC> mSteering;  ///< Steering command for atan arguments in [0, mMaxArgument]
+};
+} // namespace Xycar
+#endif // STANLEY_CONTROLLER_HPP_
@@ -0,0 +1,35 @@
+#ifndef STEERING_CONTROLLER_HPP_
+#define STEERING_CONTROLLER_HPP_
+
+#include <cstdint>
+
+namespace Xycar {
+/**
+ * @brief Common interface of the steering controllers selectable with CONTROLLER in the config file
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class SteeringController
+{
+public:
+    using Ptr = SteeringController*; ///< Pointer type of this class
+
+    virtual ~SteeringController() = default;
+
+    /**
+     * @brief Compute the steering command from the lane output
+     *
+     * @param[in] errorFromMid Error (pixel) between estimated lane position x and half of the image
+     * @return Steering angle command
+     */
+    virtual PREC getControlOutput(int32_t errorFromMid) = 0;
+
+    /**
+     * @brief Tell the controller the current speed command, for controllers depending on speed
+     *
+     * @param[in] speed Current speed command of xycar
+     */
+    virtual void setSpeed(PREC /*speed*/) {}
+};
+} // namespace Xycar
+#endif // STEERING_CONTROLLER_HPP_
@@ -0,0 +1,105 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file TaskPool.hpp
+ * @brief Small work-stealing thread pool for per-object work of the pipeline
+ * @version 1.0
+ * @date 2024-02-19
+ */
+
+#ifndef TASK_POOL_HPP_
+#define TASK_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Xycar {
+/**
+ * @brief Fixed set of workers, each with its own deque of tasks
+ *
+ * parallelFor splits an index range into chunks and deals them round robin onto the deques.
+ * A worker pops from the back of its own deque and, once it is empty, steals from the front of
+ * the others, so an expensive object does not stall the rest of the frame. The calling thread
+ * works too until the whole range is done. The body only gets the index, so results written
+ * to slot i come out in index order however the chunks were scheduled.
+ */
+class TaskPool final
+{
+public:
+    using Ptr = TaskPool*; ///< Pointer type of this class
+
+    /**
+     * @brief Construct a new Task Pool object
+     *
+     * @param[in] numWorkers Threads besides the caller. 0 runs everything on the caller
+     */
+    TaskPool(uint32_t numWorkers);
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    /**
+     * @brief Call body(i) for every i in [0, count) and return when all calls finished
+     *
+     * If body throws, the rest of its chunk is skipped, the other chunks still run, and the first
+     * exception is rethrown here once every chunk is done, so no worker is left holding the range.
+     *
+     * @param[in] count Number of indices
+     * @param[in] body Work for one index, may run on any thread
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    uint32_t getNumWorkers() const { return static_cast<uint32_t>(mWorkers.size()); }
+
+private:
+    /**
+     * @brief State of one parallelFor shared by its tasks, lives on the caller stack
+     */
+    struct Batch
+    {
+        std::atomic<size_t> remaining; ///< Indices not finished yet
+        std::mutex mutex;              ///< Guards error
+        std::exception_ptr error;      ///< First exception thrown by the body
+    };
+
+    /**
+     * @brief Index range of one parallelFor
+     */
+    struct Task
+    {
+        const std::function<void(size_t)>* body; ///< Work per index
+        size_t begin, end;                       ///< Index range
+        Batch* batch;                            ///< parallelFor the range belongs to
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;       ///< Guards tasks
+        std::deque<Task> tasks; ///< Owner pops the back, thieves take the front
+    };
+
+    bool pop(uint32_t queue, Task& task);
+    bool steal(uint32_t thief, Task& task);
+    void execute(const Task& task);
+    void work(uint32_t queue);
+
+    std::vector<std::unique_ptr<Queue>> mQueues; ///< One per worker, the last one is shared by callers
+    std::vector<std::thread> mWorkers;           ///< Worker threads
+    std::atomic<uint32_t> mNextQueue = {0};      ///< Round robin start of the next parallelFor
+    std::atomic<uint32_t> mQueuedTasks = {0};    ///< Tasks sitting in any queue
+    std::mutex mMutex;                           ///< Guards sleeping and mRunning
+    std::condition_variable mCondition;          ///< Wakes idle workers
+    bool mRunning = true;                        ///< Cleared on destruction
+};
+} // namespace Xycar
+
+#endif // TASK_POOL_HPP_
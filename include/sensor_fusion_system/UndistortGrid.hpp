@@ -0,0 +1,77 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file UndistortGrid.hpp
+ * @brief Distorted pixel -> undistorted pixel lookup grid, constant time replacement of cv::undistortPoints
+ * @version 1.0
+ * @date 2024-02-29
+ */
+
+#ifndef UNDISTORT_GRID_HPP_
+#define UNDISTORT_GRID_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+
+namespace Xycar {
+/**
+ * @brief Precomputed inverse of the lens distortion
+ *
+ * cv::undistortPoints inverts the distortion model iteratively for every point. For fixed intrinsics
+ * the inverse is a smooth function of the pixel, so the grid solves it once at nodes every cellSize
+ * pixels over the image and bilinearly interpolates between the four nodes around a point.
+ * Undistorted points use the camera matrix as the new projection, like the remap of the frame.
+ *
+ * @tparam PREC Precision of data
+ */
+template <typename PREC>
+class UndistortGrid final
+{
+public:
+    using Ptr = UndistortGrid*; ///< Pointer type of this class
+
+    static constexpr int32_t kSolverIterations = 100; ///< Iterations of the exact solution at the nodes
+
+    /**
+     * @param[in] cellSize Pixels between two nodes
+     */
+    UndistortGrid(uint32_t cellSize) : mCellSize(static_cast<PREC>(cellSize)), mInvCellSize(1 / static_cast<PREC>(cellSize)) {}
+
+    /**
+     * @brief Solve the inverse distortion at every node
+     *
+     * @param[in] cameraMatrix Camera intrinsic matrix
+     * @param[in] distCoeffs Camera distortion coefficients
+     * @param[in] imageSize Size of the distorted image, the grid covers it completely
+     */
+    void build(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Size& imageSize);
+
+    /**
+     * @brief Compare interpolated points against the iterative solution at the center of every cell
+     *
+     * @return Largest pixel distance between the grid and cv::undistortPoints
+     */
+    PREC validate(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs) const;
+
+    /**
+     * @brief Undistorted pixel of a distorted pixel. Points outside the image are extrapolated from the border cells
+     */
+    cv::Point2f undistort(const cv::Point2f& point) const;
+
+    bool isBuilt() const { return !mNodes.empty(); }
+
+private:
+    const cv::Point2f& getNode(int32_t col, int32_t row) const { return mNodes[row * mCols + col]; }
+
+    const PREC mCellSize;            ///< Pixels between two nodes
+    const PREC mInvCellSize;         ///< Inverse of mCellSize to avoid a division per lookup
+    int32_t mCols = 0;               ///< Nodes per row
+    int32_t mRows = 0;               ///< Nodes per column
+    std::vector<cv::Point2f> mNodes; ///< Undistorted position of every node, row-major
+};
+} // namespace Xycar
+
+#endif // UNDISTORT_GRID_HPP_
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/BatchMovingAverageFilter.hpp"
+#include "sensor_fusion_system/BatchPIDController.hpp"
+
+// Exhaustive PID gain sweep on a simulated lane. Every gain combination drives its own car
+// (linear kinematic bicycle in lane coordinates) through the same road and sensor noise,
+// with the moving average filter of the node in front of the controller, and the
+// configurations are ranked by RMS lateral error.
+
+using PREC = float;
+
+namespace {
+std::vector<PREC> linspace(const YAML::Node& range)
+{
+    PREC low = range[0].as<PREC>(), high = range[1].as<PREC>();
+    int32_t count = range[2].as<int32_t>();
+    std::vector<PREC> values(count);
+    for (int32_t i = 0; i < count; ++i)
+        values[i] = count > 1 ? low + (high - low) * i / (count - 1) : low;
+    return values;
+}
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <config.yaml>" << std::endl;
+        return 1;
+    }
+
+    YAML::Node config = YAML::LoadFile(argv[1]);
+    const YAML::Node sweep = config["SWEEP"];
+    const PREC metersPerPixel = config["GEOMETRY"]["METERS_PER_PIXEL"].as<PREC>();
+    const PREC wheelbase = config["GEOMETRY"]["WHEELBASE"].as<PREC>();
+    const PREC radianPerCommand = static_cast<PREC>(M_PI / 180.0) / config["GEOMETRY"]["COMMAND_PER_DEGREE"].as<PREC>();
+    const PREC speed = sweep["SPEED"].as<PREC>() * config["GEOMETRY"]["SPEED_TO_MPS"].as<PREC>();
+    const uint32_t sampleSize = config["MOVING_AVERAGE_FILTER"]["SAMPLE_SIZE"].as<uint32_t>();
+    const PREC dt = sweep["CONTROL_PERIOD"].as<PREC>();
+    const int32_t steps = sweep["STEPS"].as<int32_t>();
+    const PREC steeringLimit = sweep["STEERING_LIMIT"].as<PREC>();
+    const PREC noisePixels = sweep["NOISE_PIXELS"].as<PREC>();
+    const PREC curvatureAmplitude = sweep["CURVATURE_AMPLITUDE"].as<PREC>();
+    const PREC curvatureWavelength = sweep["CURVATURE_WAVELENGTH"].as<PREC>();
+    const PREC initialOffset = sweep["INITIAL_OFFSET"].as<PREC>();
+
+    const std::vector<PREC> pValues = linspace(sweep["P_GAIN"]);
+    const std::vector<PREC> iValues = linspace(sweep["I_GAIN"]);
+    const std::vector<PREC> dValues = linspace(sweep["D_GAIN"]);
+    std::vector<PREC> pGains, iGains, dGains;
+    for (PREC p : pValues)
+        for (PREC i : iValues)
+            for (PREC d : dValues)
+            {
+                pGains.push_back(p);
+                iGains.push_back(i);
+                dGains.push_back(d);
+            }
+    const size_t n = pGains.size();
+
+    Xycar::BatchPIDController<PREC> controllers(pGains, iGains, dGains);
+    Xycar::BatchMovingAverageFilter<PREC> filters(sampleSize, n);
+
+    // lateral (m, left positive) and heading (rad) error of each car, and squared error integral
+    std::vector<PREC> lateral(n, initialOffset), heading(n, 0), squaredError(n, 0), outputs(n);
+    std::vector<int32_t> measurements(n);
+    std::mt19937 generator(0);
+    std::normal_distribution<PREC> noise(0, noisePixels);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int32_t step = 0; step < steps; ++step)
+    {
+        // road and noise are shared, so every configuration sees exactly the same run
+        const PREC curvature = curvatureAmplitude * std::sin(static_cast<PREC>(2.0 * M_PI) * speed * dt * step / curvatureWavelength);
+        const PREC measurementNoise = noise(generator);
+
+        // lane position relative to the image centre, positive when the car is left of the lane centre
+        for (size_t k = 0; k < n; ++k)
+            measurements[k] = static_cast<int32_t>(std::nearbyint(lateral[k] / metersPerPixel + measurementNoise));
+
+        filters.addSamples(measurements.data());
+        controllers.getControlOutput(filters.getResults(), outputs.data());
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            // the controller steers right with positive commands, the model turns left with positive angles
+            PREC wheelAngle = -std::clamp(outputs[k], -steeringLimit, steeringLimit) * radianPerCommand;
+            lateral[k] += speed * dt * heading[k];
+            heading[k] += speed * dt * (wheelAngle / wheelbase - curvature);
+            squaredError[k] += lateral[k] * lateral[k];
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        // diverged runs end as inf/nan, rank them last
+        PREC ea = std::isfinite(squaredError[a]) ? squaredError[a] : INFINITY;
+        PREC eb = std::isfinite(squaredError[b]) ? squaredError[b] : INFINITY;
+        return ea < eb;
+    });
+
+    std::cout << n << " configurations x " << steps << " steps in " << elapsed << " s (" << elapsed * 1e9 / (static_cast<double>(n) * steps)
+              << " ns per controller step)" << std::endl;
+    const size_t numBest = std::min<size_t>(sweep["REPORT"].as<size_t>(), n);
+    for (size_t rank = 0; rank < numBest; ++rank)
+    {
+        size_t k = order[rank];
+        std::cout << "P " << pGains[k] << " I " << iGains[k] << " D " << dGains[k] << " -> RMS lateral error " << std::sqrt(squaredError[k] / steps)
+                  << " m" << std::endl;
+    }
+    return 0;
+}
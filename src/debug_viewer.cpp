@@ -0,0 +1,47 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "sensor_fusion_system/DebugRing.hpp"
+
+int32_t main(int32_t argc, char** argv)
+{
+    std::string name = argc > 1 ? argv[1] : "/xycar_debug";
+
+    Xycar::DebugRing::Ptr ring = new Xycar::DebugRing(name);
+    while (!ring->isOpen())
+    {
+        std::cerr << "Waiting for " << name << " ..." << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        delete ring;
+        ring = new Xycar::DebugRing(name);
+    }
+
+    cv::Mat frame;
+    Xycar::DebugResult result;
+    uint64_t lastFrameId = 0;
+
+    while (true)
+    {
+        if (ring->readLatest(frame, result) && result.frameId != lastFrameId)
+        {
+            lastFrameId = result.frameId;
+            for (uint32_t i = 0; i < result.numBoxes; ++i)
+            {
+                const Xycar::DebugBox& box = result.boxes[i];
+                std::string text = box.distance < 0 ? cv::format("%u pts", box.numPoints) : cv::format("%u pts %.2f m", box.numPoints, box.distance);
+                if (box.rangeSource == Xycar::RangeSource::GROUND_PLANE)
+                    text += " (ground)";
+                cv::putText(frame, text, cv::Point(box.x, box.y + box.height + 15), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255), 1, cv::LINE_AA);
+            }
+            cv::imshow(name, frame);
+        }
+
+        if (cv::waitKey(10) == 27)
+            break;
+    }
+
+    delete ring;
+    return 0;
+}
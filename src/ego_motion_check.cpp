@@ -0,0 +1,89 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "sensor_fusion_system/EgoMotion.hpp"
+
+// Check of the ego-motion propagation used by FUSE against a synthetic car driving at constant speed
+// and wheel angle past static obstacles. The exact pose of the car on its arc gives where an obstacle
+// seen at the scan time has to be at the frame time. Exits non-zero on a violation.
+
+namespace {
+constexpr double kWheelbase = 0.325; ///< Xycar wheelbase (m)
+constexpr double kTolerance = 1e-3;  ///< Allowed position error (m)
+
+bool gFailed = false;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        gFailed = true;
+    }
+}
+
+/// Exact position at time dt of a static point, seen at (x, y) at time 0, for a car on a circle (or a line)
+cv::Point2d exact(double x, double y, double speed, double wheelAngle, double dt)
+{
+    const double distance = speed * dt;
+    const double curvature = std::tan(wheelAngle) / kWheelbase;
+    const double yaw = distance * curvature;
+    double px = distance;
+    double py = 0;
+    if (std::abs(curvature) > 1e-12)
+    {
+        px = std::sin(yaw) / curvature;
+        py = (1 - std::cos(yaw)) / curvature;
+    }
+    x -= px;
+    y -= py;
+    return cv::Point2d(std::cos(yaw) * x + std::sin(yaw) * y, -std::sin(yaw) * x + std::cos(yaw) * y);
+}
+
+bool near(const cv::Point2d& a, const cv::Point2d& b) { return std::hypot(a.x - b.x, a.y - b.y) <= kTolerance; }
+} // namespace
+
+int32_t main()
+{
+    using Motion = Xycar::EgoMotion<double>;
+    {
+        // driving forward brings an obstacle ahead closer, by the distance driven
+        const cv::Point2d moved = Motion::fromCommand(1.0, 0.0, kWheelbase, 0.1).apply(2.0, 0.3);
+        check(near(moved, cv::Point2d(1.9, 0.3)), "straight: obstacle ahead did not come 0.1 m closer");
+        const cv::Point2d back = Motion::fromCommand(1.0, 0.0, kWheelbase, -0.1).apply(2.0, 0.3);
+        check(near(back, cv::Point2d(2.1, 0.3)), "straight: a frame before the scan did not see the obstacle farther away");
+        const cv::Point2d still = Motion().apply(2.0, 0.3);
+        check(near(still, cv::Point2d(2.0, 0.3)), "no motion moved the point");
+    }
+    {
+        // turning left, an obstacle straight ahead drifts to the right of the car
+        const cv::Point2d moved = Motion::fromCommand(1.5, 0.3, kWheelbase, 0.1).apply(2.0, 0.0);
+        check(moved.y < 0, "left turn: obstacle ahead did not move to the right");
+        const cv::Point2d mirrored = Motion::fromCommand(1.5, -0.3, kWheelbase, 0.1).apply(2.0, 0.0);
+        check(near(mirrored, cv::Point2d(moved.x, -moved.y)), "right turn is not the mirror of the left turn");
+    }
+
+    // constant speed and wheel angle over the scan to frame gaps the pipeline sees (up to one scan period)
+    double maxError = 0;
+    for (double speed : {0.5, 1.0, 2.0})
+    {
+        for (double wheelAngle : {-0.4, -0.1, 0.0, 0.2, 0.4})
+        {
+            for (double dt = -0.1; dt <= 0.1001; dt += 0.01)
+            {
+                for (const cv::Point2d& obstacle : {cv::Point2d(1.0, 0.0), cv::Point2d(2.5, -0.6), cv::Point2d(0.6, 0.8)})
+                {
+                    const cv::Point2d moved = Motion::fromCommand(speed, wheelAngle, kWheelbase, dt).apply(obstacle.x, obstacle.y);
+                    const cv::Point2d truth = exact(obstacle.x, obstacle.y, speed, wheelAngle, dt);
+                    maxError = std::max(maxError, std::hypot(moved.x - truth.x, moved.y - truth.y));
+                }
+            }
+        }
+    }
+    std::cout << "max propagation error on the synthetic arcs: " << maxError << " m (bound " << kTolerance << " m)" << std::endl;
+    check(maxError <= kTolerance, "propagation off the exact arc");
+
+    std::cout << (gFailed ? "FAILED" : "all checks passed") << std::endl;
+    return gFailed ? 1 : 0;
+}
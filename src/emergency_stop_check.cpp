@@ -0,0 +1,102 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "sensor_fusion_system/EmergencyStop.hpp"
+
+// Synthetic-scan check of the lidar emergency stop. Each case builds a full circle scan with
+// everything far away, puts returns on chosen beams and checks the latched stop state.
+// Exits non-zero on a violation.
+
+namespace {
+constexpr uint32_t kNumBeams = 360;                                     ///< One beam per degree
+constexpr float kAngleMin = static_cast<float>(-M_PI);                  ///< Beam 180 points forward
+constexpr float kAngleIncrement = static_cast<float>(2 * M_PI / kNumBeams);
+constexpr float kRangeMin = 0.05f;                                      ///< Driver range_min
+constexpr uint32_t kForwardBeam = kNumBeams / 2;
+constexpr uint32_t kMinPoints = 3;
+constexpr uint32_t kClearScans = 2;
+
+bool gFailed = false;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        gFailed = true;
+    }
+}
+
+/// Corridor 0.4 m wide, reaches 0.65 m ahead of the lidar at 1 m/s (0.1 offset + 0.1 reaction + 0.25 braking + 0.2 margin)
+Xycar::EmergencyStop<float> makeStop()
+{
+    Xycar::EmergencyStop<float> stop(0.f, 0.2f, 0.1f, 0.2f, 0.1f, 2.f, kMinPoints, kClearScans);
+    stop.setScanGeometry(kAngleMin, kAngleIncrement, kNumBeams, kRangeMin);
+    return stop;
+}
+
+std::vector<float> clearScan() { return std::vector<float>(kNumBeams, 10.f); }
+
+/// Returns at range on count beams centred on a beam
+std::vector<float> scanWith(uint32_t centre, uint32_t count, float range)
+{
+    std::vector<float> ranges = clearScan();
+    for (uint32_t i = 0; i < count; ++i)
+        ranges[centre - count / 2 + i] = range;
+    return ranges;
+}
+
+bool update(Xycar::EmergencyStop<float>& stop, const std::vector<float>& ranges, float speed = 1.f)
+{
+    return stop.update(ranges.data(), ranges.size(), speed);
+}
+} // namespace
+
+int32_t main()
+{
+    {
+        Xycar::EmergencyStop<float> stop = makeStop();
+        check(!update(stop, clearScan()), "stopped on a clear scan");
+        check(update(stop, scanWith(kForwardBeam, kMinPoints, 0.5f)), "obstacle inside the corridor not detected");
+    }
+    {
+        Xycar::EmergencyStop<float> stop = makeStop();
+        check(!update(stop, scanWith(kForwardBeam, kMinPoints - 1, 0.5f)), "stopped on fewer than MIN_POINTS returns");
+        check(!update(stop, scanWith(kForwardBeam, kMinPoints, 2.f)), "stopped on an obstacle beyond the stopping distance");
+        // 60 degrees to the side at 0.5 m is 0.43 m off the centre line
+        check(!update(stop, scanWith(kForwardBeam + 60, kMinPoints, 0.5f)), "stopped on an obstacle beside the corridor");
+        check(!update(stop, scanWith(kMinPoints, kMinPoints, 0.3f)), "stopped on an obstacle behind the lidar");
+    }
+    {
+        Xycar::EmergencyStop<float> stop = makeStop();
+        std::vector<float> ranges = clearScan();
+        const float invalid[] = {std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(), 0.f, kRangeMin,
+                                 kRangeMin / 2};
+        for (uint32_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+            ranges[kForwardBeam - 2 + i] = invalid[i];
+        check(!update(stop, ranges), "stopped on NaN, inf or range_min returns");
+    }
+    {
+        Xycar::EmergencyStop<float> stop = makeStop();
+        const std::vector<float> ranges = scanWith(kForwardBeam, kMinPoints, 0.9f);
+        check(!update(stop, ranges, 0.f), "stopped at standstill on an obstacle outside the standstill corridor");
+        check(update(stop, ranges, 2.f), "corridor did not grow with speed");
+    }
+    {
+        Xycar::EmergencyStop<float> stop = makeStop();
+        const std::vector<float> blocked = scanWith(kForwardBeam, kMinPoints, 0.5f);
+        check(update(stop, blocked), "obstacle inside the corridor not detected");
+        check(update(stop, clearScan()), "released before CLEAR_SCANS clear scans");
+        check(update(stop, blocked), "obstacle during release not detected");
+        for (uint32_t i = 0; i + 1 < kClearScans; ++i)
+            check(update(stop, clearScan()), "a new obstacle did not restart the release count");
+        check(!update(stop, clearScan()), "not released after CLEAR_SCANS clear scans");
+        check(!stop.isStopped(), "isStopped disagrees with update");
+    }
+
+    std::cout << (gFailed ? "FAILED" : "all checks passed") << std::endl;
+    return gFailed ? 1 : 0;
+}
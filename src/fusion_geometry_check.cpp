@@ -0,0 +1,149 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/CameraDetector.hpp"
+#include "sensor_fusion_system/EgoMotion.hpp"
+
+// Check that lidar positions (getVCSCoordPointsFromLidar) and ground-plane positions (getGroundPoint)
+// come out in the same VCS frame. Both calibrations are solved from synthetic correspondences of a
+// known mounting: the lidar object frame 10 cm below and 5 cm behind the camera, the VCS calibration
+// frame yawed by 3 degrees and offset like the real one, and the ground put at the height of the scan
+// plane. Every sampled pixel below the horizon is then a point of the scan plane on the ground, and
+// both paths must return the same VCS point as the known mounting. Exits non-zero on a violation.
+
+namespace {
+bool gFailed = false;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        gFailed = true;
+    }
+}
+
+/// Pinhole projection with the distortion of the config, the image points a calibration would have
+std::vector<cv::Point2f> project(const std::vector<cv::Point3f>& points, const cv::Matx33d& R, const cv::Vec3d& t, const cv::Mat& cameraMatrix,
+                                 const cv::Mat& distCoeffs)
+{
+    cv::Mat rvec;
+    cv::Rodrigues(cv::Mat(R), rvec);
+    std::vector<cv::Point2f> imagePoints;
+    cv::projectPoints(points, rvec, cv::Mat(t), cameraMatrix, distCoeffs, imagePoints);
+    return imagePoints;
+}
+
+/// Grid of calibration targets in front of the camera, not coplanar so solvePnP has a unique answer
+std::vector<cv::Point3f> makeTargets()
+{
+    std::vector<cv::Point3f> points;
+    for (float x : {-0.6f, -0.2f, 0.2f, 0.6f})
+    {
+        for (float y : {-0.2f, 0.f, 0.1f})
+        {
+            for (float z : {1.f, 1.6f, 2.4f})
+                points.emplace_back(x, y, z);
+        }
+    }
+    return points;
+}
+
+/// VCS (x forward, y left, z up) of a point of the VCS calibration frame (x right, y down, z forward)
+cv::Point3f toVCS(const cv::Vec3d& calibration) { return cv::Point3f(calibration(2), -calibration(0), -calibration(1)); }
+
+float distance(const cv::Point3f& a, const cv::Point3f& b) { return std::sqrt((a - b).dot(a - b)); }
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <config.yaml> [max error m, default 0.01]" << std::endl;
+        return 1;
+    }
+
+    YAML::Node config = YAML::LoadFile(argv[1]);
+    const double maxAllowedError = argc > 2 ? std::stod(argv[2]) : 0.01;
+    const int32_t width = config["IMAGE"]["WIDTH"].as<int32_t>();
+    const int32_t height = config["IMAGE"]["HEIGHT"].as<int32_t>();
+
+    cv::Mat cameraMatrix = cv::Mat::zeros(3, 3, CV_64F);
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        for (int32_t j = 0; j < 3; ++j)
+            cameraMatrix.at<double>(i, j) = config["CAMERA"]["CAMERA_MATRIX2"][i][j].as<double>();
+    }
+    std::vector<double> distortion = config["CAMERA"]["DIST_COEFF2"].as<std::vector<double>>();
+    cv::Mat distCoeffs(distortion, true);
+    const cv::Matx33d K = cameraMatrix;
+
+    // known mounting: lidar object frame axis aligned with the camera, VCS calibration frame yawed
+    const cv::Matx33d lidarR = cv::Matx33d::eye();
+    const cv::Vec3d lidarT(0, 0.1, 0.05);
+    cv::Matx33d vcsR;
+    cv::Rodrigues(cv::Vec3d(0, 3 * M_PI / 180, 0), vcsR);
+    const cv::Vec3d vcsT(-0.04, 0.15, 0);
+
+    // yaw keeps the y axis, so the scan plane (camera y = kLidarPlaneY + 0.1) is the ground at this height
+    const double planeCameraY = Xycar::CameraDetector<double>::kLidarPlaneY + lidarT(1);
+    config["GROUND_PLANE"]["HEIGHT"] = planeCameraY - vcsT(1);
+    config["GROUND_PLANE"]["RANGE_MAX"] = 6.0;
+    config["LIDAR"]["PROJECTION_LUT"] = false;
+    config["LIDAR"]["FRUSTUM_CULLING"] = false;
+    config["DEBUG"] = false;
+
+    Xycar::CameraDetector<double> detector(config, nullptr);
+    const std::vector<cv::Point3f> targets = makeTargets();
+    detector.getLidarExtrinsicMatrix(project(targets, lidarR, lidarT, cameraMatrix, distCoeffs), targets);
+    detector.getVCSExtrinsicMatrix(project(targets, vcsR, vcsT, cameraMatrix, distCoeffs), targets);
+
+    double maxLidarError = 0;
+    double maxGroundError = 0;
+    uint32_t compared = 0;
+    for (int32_t v = height / 2; v < height; v += 8)
+    {
+        for (int32_t u = width / 10; u < width * 9 / 10; u += 16)
+        {
+            // the scan plane point seen at pixel (u, v) of the undistorted image
+            const cv::Vec3d ray = K.inv() * cv::Vec3d(u, v, 1);
+            if (ray(1) <= 0)
+                continue;
+            const cv::Vec3d camera = ray * (planeCameraY / ray(1));
+            const cv::Point3f truth = toVCS(vcsR.t() * (camera - vcsT));
+
+            cv::Point3f ground;
+            if (!detector.getGroundPoint(cv::Rect(u - 1, v - 2, 2, 2), ground))
+                continue;
+
+            const cv::Vec3d object = lidarR.t() * (camera - lidarT);
+            const cv::Point3f lidar = detector.getVCSCoordPointsFromLidar(cv::Point3f(object(0), object(1), object(2)));
+
+            maxLidarError = std::max(maxLidarError, static_cast<double>(distance(lidar, truth)));
+            maxGroundError = std::max(maxGroundError, static_cast<double>(distance(ground, truth)));
+            check(distance(lidar, ground) <= maxAllowedError,
+                  "pixel (" + std::to_string(u) + ", " + std::to_string(v) + "): lidar and ground plane positions disagree");
+            ++compared;
+        }
+    }
+
+    // a return straight ahead of the lidar is ahead of the car, not behind it
+    const cv::Point3f ahead = detector.getVCSCoordPointsFromLidar(Xycar::CameraDetector<double>::toLidarObjectPoint(M_PI, 2.0));
+    check(ahead.x > 1.5 && std::abs(ahead.y) < 0.5, "lidar return 2 m ahead is not ahead of the car in VCS");
+    // and driving 0.1 m forward between the scan and the frame brings it 0.1 m closer, as FUSE assumes
+    const cv::Point_<double> moved = Xycar::EgoMotion<double>::fromCommand(1.0, 0.0, 0.325, 0.1).apply(ahead.x, ahead.y);
+    check(std::abs(moved.x - (ahead.x - 0.1)) < 1e-6 && std::abs(moved.y - ahead.y) < 1e-6,
+          "forward motion did not bring a lidar return ahead closer");
+
+    std::cout << compared << " scan plane points, max error against the mounting: lidar " << maxLidarError << " m, ground plane "
+              << maxGroundError << " m (bound " << maxAllowedError << " m)" << std::endl;
+    check(compared > 0, "no pixel hit the ground within range");
+    check(maxLidarError <= maxAllowedError, "lidar positions off the known mounting");
+    check(maxGroundError <= maxAllowedError, "ground plane positions off the known mounting");
+
+    std::cout << (gFailed ? "FAILED" : "all checks passed") << std::endl;
+    return gFailed ? 1 : 0;
+}
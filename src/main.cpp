@@ -5,8 +5,16 @@ using PREC = float;
 int32_t main(int32_t argc, char** argv)
 {
     ros::init(argc, argv, "Lane Keeping System");
-    Xycar::LaneKeepingSystem<PREC> laneKeepingSystem;
-    laneKeepingSystem.run();
+    try
+    {
+        Xycar::LaneKeepingSystem<PREC> laneKeepingSystem;
+        laneKeepingSystem.run();
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+// Offline solver of the explicit MPC table read by Xycar::ExplicitMPCController.
+//
+// Model (kinematic bicycle linearized around the lane centre, no curvature preview):
+//   e_y'   = v * e_psi
+//   e_psi' = v / L * delta
+// discretized exactly with the control period. For every grid state the box constrained QP
+//   min sum_k x_k' Q x_k + R delta_k^2,  |delta_k| <= delta_max
+// is condensed to 0.5 U' H U + (F x0)' U and solved with accelerated projected gradient.
+// Only the first move is stored.
+
+namespace {
+using Matrix = std::vector<std::vector<double>>;
+
+Matrix zeros(size_t rows, size_t cols) { return Matrix(rows, std::vector<double>(cols, 0.0)); }
+
+struct Problem
+{
+    Matrix H;               ///< N x N Hessian
+    Matrix F;               ///< N x 2 linear term per initial state
+    double step;            ///< 1 / Lipschitz bound of H
+};
+
+Problem buildProblem(double speed, double wheelbase, double dt, int32_t horizon, double qLateral, double qHeading, double qTerminal, double r)
+{
+    // x_{k+1} = A x_k + B u_k
+    const double a01 = speed * dt;
+    const double b0 = speed * speed * dt * dt / (2.0 * wheelbase);
+    const double b1 = speed * dt / wheelbase;
+
+    // predicted states: x_{i+1} = A^{i+1} x0 + sum_{j<=i} A^{i-j} B u_j, with A^n = [1 n*a01; 0 1]
+    Matrix Su = zeros(2 * horizon, horizon);
+    Matrix Sx = zeros(2 * horizon, 2);
+    for (int32_t i = 0; i < horizon; ++i)
+    {
+        Sx[2 * i][0] = 1.0;
+        Sx[2 * i][1] = (i + 1) * a01;
+        Sx[2 * i + 1][1] = 1.0;
+        for (int32_t j = 0; j <= i; ++j)
+        {
+            Su[2 * i][j] = b0 + (i - j) * a01 * b1;
+            Su[2 * i + 1][j] = b1;
+        }
+    }
+
+    std::vector<double> q(2 * horizon);
+    for (int32_t i = 0; i < horizon; ++i)
+    {
+        double weight = i == horizon - 1 ? qTerminal : 1.0;
+        q[2 * i] = qLateral * weight;
+        q[2 * i + 1] = qHeading * weight;
+    }
+
+    Problem problem;
+    problem.H = zeros(horizon, horizon);
+    problem.F = zeros(horizon, 2);
+    for (int32_t a = 0; a < horizon; ++a)
+    {
+        for (int32_t b = 0; b < horizon; ++b)
+        {
+            double sum = a == b ? r : 0.0;
+            for (int32_t k = 0; k < 2 * horizon; ++k)
+                sum += Su[k][a] * q[k] * Su[k][b];
+            problem.H[a][b] = sum;
+        }
+        for (int32_t c = 0; c < 2; ++c)
+        {
+            double sum = 0.0;
+            for (int32_t k = 0; k < 2 * horizon; ++k)
+                sum += Su[k][a] * q[k] * Sx[k][c];
+            problem.F[a][c] = sum;
+        }
+    }
+
+    // Gershgorin bound of the largest eigenvalue
+    double lipschitz = 0.0;
+    for (const auto& row : problem.H)
+    {
+        double sum = 0.0;
+        for (double value : row)
+            sum += std::abs(value);
+        lipschitz = std::max(lipschitz, sum);
+    }
+    problem.step = 1.0 / lipschitz;
+    return problem;
+}
+
+double solveFirstMove(const Problem& problem, double lateral, double heading, double limit, int32_t iterations)
+{
+    const size_t n = problem.H.size();
+    std::vector<double> g(n), u(n, 0.0), previous(n, 0.0), y(n, 0.0);
+    for (size_t i = 0; i < n; ++i)
+        g[i] = problem.F[i][0] * lateral + problem.F[i][1] * heading;
+
+    double t = 1.0;
+    for (int32_t iteration = 0; iteration < iterations; ++iteration)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            double gradient = g[i];
+            for (size_t j = 0; j < n; ++j)
+                gradient += problem.H[i][j] * y[j];
+            u[i] = std::clamp(y[i] - problem.step * gradient, -limit, limit);
+        }
+
+        double nextT = 0.5 * (1.0 + std::sqrt(1.0 + 4.0 * t * t));
+        for (size_t i = 0; i < n; ++i)
+            y[i] = u[i] + (t - 1.0) / nextT * (u[i] - previous[i]);
+        previous = u;
+        t = nextT;
+    }
+    return u[0];
+}
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <config.yaml>" << std::endl;
+        return 1;
+    }
+
+    YAML::Node config = YAML::LoadFile(argv[1]);
+    const YAML::Node mpc = config["MPC"];
+    const double wheelbase = config["GEOMETRY"]["WHEELBASE"].as<double>();
+    const double commandPerDegree = config["GEOMETRY"]["COMMAND_PER_DEGREE"].as<double>();
+    const double dt = mpc["CONTROL_PERIOD"].as<double>();
+    const int32_t horizon = mpc["HORIZON"].as<int32_t>();
+    const double qLateral = mpc["Q_LATERAL"].as<double>();
+    const double qHeading = mpc["Q_HEADING"].as<double>();
+    const double qTerminal = mpc["Q_TERMINAL"].as<double>();
+    const double r = mpc["R"].as<double>();
+    const int32_t iterations = mpc["ITERATIONS"].as<int32_t>();
+    const double limit = mpc["STEERING_LIMIT"].as<double>() / commandPerDegree * M_PI / 180.0;
+    const std::vector<double> speeds = mpc["SPEEDS"].as<std::vector<double>>();
+    const double lateralRange = mpc["LATERAL_RANGE"].as<double>();
+    const double headingRange = mpc["HEADING_RANGE"].as<double>();
+    const int32_t lateralCount = mpc["LATERAL_COUNT"].as<int32_t>();
+    const int32_t headingCount = mpc["HEADING_COUNT"].as<int32_t>();
+    const std::string tablePath = mpc["TABLE"].as<std::string>();
+
+    const double lateralStep = 2.0 * lateralRange / (lateralCount - 1);
+    const double headingStep = 2.0 * headingRange / (headingCount - 1);
+
+    std::vector<double> steering;
+    steering.reserve(speeds.size() * lateralCount * headingCount);
+    for (double speed : speeds)
+    {
+        // the model loses controllability at standstill, keep a small speed so H stays positive definite
+        Problem problem = buildProblem(std::max(speed, 0.05), wheelbase, dt, horizon, qLateral, qHeading, qTerminal, r);
+        for (int32_t i = 0; i < lateralCount; ++i)
+        {
+            for (int32_t j = 0; j < headingCount; ++j)
+                steering.push_back(solveFirstMove(problem, -lateralRange + i * lateralStep, -headingRange + j * headingStep, limit, iterations));
+        }
+        std::cout << "speed " << speed << " m/s: " << lateralCount * headingCount << " states solved" << std::endl;
+    }
+
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+    out << YAML::Key << "SPEEDS" << YAML::Value << YAML::Flow << speeds;
+    out << YAML::Key << "LATERAL_MIN" << YAML::Value << -lateralRange;
+    out << YAML::Key << "LATERAL_STEP" << YAML::Value << lateralStep;
+    out << YAML::Key << "LATERAL_COUNT" << YAML::Value << lateralCount;
+    out << YAML::Key << "HEADING_MIN" << YAML::Value << -headingRange;
+    out << YAML::Key << "HEADING_STEP" << YAML::Value << headingStep;
+    out << YAML::Key << "HEADING_COUNT" << YAML::Value << headingCount;
+    out << YAML::Key << "STEERING" << YAML::Value << YAML::Flow << steering;
+    out << YAML::EndMap;
+
+    std::ofstream file(tablePath);
+    if (!file.is_open())
+    {
+        std::cerr << "Could not write " << tablePath << std::endl;
+        return 1;
+    }
+    file << out.c_str() << std::endl;
+    std::cout << "wrote " << steering.size() << " entries to " << tablePath << std::endl;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/CameraDetector.hpp"
+#include "sensor_fusion_system/ProjectionLookupTable.hpp"
+
+// Check of the lidar projection lookup table against cv::projectPoints. The table is built with the
+// intrinsics and LUT_* settings of the config and a synthetic mounting (lidar 10 cm below and 5 cm
+// behind the camera, axes aligned), then every beam is sampled at the middle of each range bin, where
+// linear interpolation is worst, and at random ranges. Only samples landing inside the image count.
+// Exits non-zero if the error exceeds the bound or a beam behind the camera is reported as visible.
+
+namespace {
+bool gFailed = false;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        gFailed = true;
+    }
+}
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <config.yaml> [max error px, default 0.5]" << std::endl;
+        return 1;
+    }
+
+    YAML::Node config = YAML::LoadFile(argv[1]);
+    const double maxAllowedError = argc > 2 ? std::stod(argv[2]) : 0.5;
+    const int32_t width = config["IMAGE"]["WIDTH"].as<int32_t>();
+    const int32_t height = config["IMAGE"]["HEIGHT"].as<int32_t>();
+
+    cv::Mat cameraMatrix = cv::Mat::zeros(3, 3, CV_64F);
+    for (int32_t i = 0; i < 3; ++i)
+    {
+        for (int32_t j = 0; j < 3; ++j)
+            cameraMatrix.at<double>(i, j) = config["CAMERA"]["CAMERA_MATRIX2"][i][j].as<double>();
+    }
+    std::vector<double> distortion = config["CAMERA"]["DIST_COEFF2"].as<std::vector<double>>();
+    cv::Mat distCoeffs(distortion, true);
+
+    cv::Mat rvec = cv::Mat::zeros(3, 1, CV_64F);
+    cv::Mat tvec = cv::Mat::zeros(3, 1, CV_64F);
+    tvec.at<double>(1, 0) = 0.1;
+    tvec.at<double>(2, 0) = 0.05;
+
+    constexpr uint32_t kNumBeams = 505;
+    const double angleMin = -M_PI;
+    const double angleIncrement = 2 * M_PI / kNumBeams;
+    const double rangeMin = config["LIDAR"]["LUT_RANGE_MIN"].as<double>();
+    const double rangeMax = config["LIDAR"]["LUT_RANGE_MAX"].as<double>();
+    const uint32_t numBins = config["LIDAR"]["LUT_RANGE_BINS"].as<uint32_t>();
+
+    Xycar::ProjectionLookupTable<double> table(rangeMin, rangeMax, numBins);
+    table.build(angleMin, angleIncrement, kNumBeams, &Xycar::CameraDetector<double>::toLidarObjectPoint, rvec, tvec, cameraMatrix,
+                distCoeffs);
+    check(table.isBuiltFor(angleMin, angleIncrement, kNumBeams), "table not built for the scan geometry");
+
+    // samples: middle of every bin, then random ranges
+    const double binWidth = (rangeMax - rangeMin) / (numBins - 1);
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> randomRange(rangeMin, rangeMax);
+    std::vector<uint32_t> beams;
+    std::vector<double> ranges;
+    std::vector<cv::Point3f> objectPoints;
+    for (uint32_t beam = 0; beam < kNumBeams; ++beam)
+    {
+        const double angle = angleMin + beam * angleIncrement;
+        for (uint32_t bin = 0; bin + 1 < numBins; ++bin)
+        {
+            beams.push_back(beam);
+            ranges.push_back(rangeMin + (bin + 0.5) * binWidth);
+        }
+        for (uint32_t k = 0; k < 64; ++k)
+        {
+            beams.push_back(beam);
+            ranges.push_back(randomRange(generator));
+        }
+        for (size_t i = objectPoints.size(); i < ranges.size(); ++i)
+            objectPoints.push_back(Xycar::CameraDetector<double>::toLidarObjectPoint(angle, ranges[i]));
+    }
+
+    std::vector<cv::Point2f> exactPoints;
+    cv::projectPoints(objectPoints, rvec, tvec, cameraMatrix, distCoeffs, exactPoints);
+
+    double maxError = 0;
+    uint32_t compared = 0;
+    for (size_t i = 0; i < exactPoints.size(); ++i)
+    {
+        const cv::Point3f& p = objectPoints[i];
+        const bool inFront = p.z + tvec.at<double>(2, 0) > 0;
+        const bool inImage = exactPoints[i].x >= 0 && exactPoints[i].x < width && exactPoints[i].y >= 0 && exactPoints[i].y < height;
+
+        cv::Point2f tablePoint;
+        const bool found = table.lookup(beams[i], ranges[i], tablePoint);
+        if (!inFront)
+        {
+            check(!found, "beam " + std::to_string(beams[i]) + " behind the camera has a table point");
+            continue;
+        }
+        if (!inImage || !found)
+            continue;
+
+        maxError = std::max<double>(maxError, std::hypot(tablePoint.x - exactPoints[i].x, tablePoint.y - exactPoints[i].y));
+        ++compared;
+    }
+
+    std::cout << compared << " samples inside the image, max error " << maxError << " px (bound " << maxAllowedError << " px)" << std::endl;
+    check(compared > 0, "no sample landed inside the image");
+    check(maxError <= maxAllowedError, "table error above the bound");
+
+    std::cout << (gFailed ? "FAILED" : "all checks passed") << std::endl;
+    return gFailed ? 1 : 0;
+}
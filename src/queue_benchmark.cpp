@@ -0,0 +1,206 @@
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sensor_fusion_system/LockFreeQueue.hpp"
+
+// Throughput benchmark and stress check of the stage handoff queues. Every run verifies that
+// nothing is duplicated or reordered per producer, that BLOCK loses nothing and that
+// received + dropped == sent for the dropping policies. Exits non-zero on a violation.
+
+namespace {
+constexpr uint64_t kProducerShift = 48; ///< Producer id lives in the top bits of each value
+constexpr uint64_t kSequenceMask = (uint64_t(1) << kProducerShift) - 1;
+
+bool gFailed = false;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << std::endl;
+        gFailed = true;
+    }
+}
+
+void report(const std::string& name, uint64_t received, uint64_t dropped, double seconds)
+{
+    std::cout << name << ": " << received / seconds * 1e-6 << " M/s received, " << dropped << " dropped" << std::endl;
+}
+
+/**
+ * @brief Run producers and one consumer over a queue with push(value) / pop(value)
+ */
+template <typename Queue>
+void run(const std::string& name, Queue& queue, uint32_t numProducers, uint64_t perProducer, bool lossless)
+{
+    std::vector<uint64_t> lastSequence(numProducers, 0);
+    uint64_t received = 0;
+    std::atomic<uint32_t> finished(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < numProducers; ++p)
+    {
+        producers.emplace_back([&, p] {
+            for (uint64_t i = 1; i <= perProducer; ++i)
+                queue.push((static_cast<uint64_t>(p) << kProducerShift) | i);
+            finished.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    uint64_t value;
+    while (true)
+    {
+        if (queue.pop(value))
+        {
+            uint64_t producer = value >> kProducerShift;
+            uint64_t sequence = value & kSequenceMask;
+            check(producer < numProducers, name + " unknown producer");
+            check(sequence > lastSequence[producer], name + " reordered or duplicated value");
+            check(!lossless || sequence == lastSequence[producer] + 1, name + " lost value");
+            lastSequence[producer] = sequence;
+            ++received;
+        }
+        else if (finished.load(std::memory_order_acquire) == numProducers)
+        {
+            // producers are done, drain what is left
+            while (queue.pop(value))
+                ++received;
+            break;
+        }
+        else
+            std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (std::thread& producer : producers)
+        producer.join();
+
+    uint64_t dropped = queue.getDroppedCount();
+    check(received + dropped == numProducers * perProducer, name + " received + dropped != sent");
+    check(!lossless || dropped == 0, name + " dropped values");
+    report(name, received, dropped, seconds);
+}
+
+/**
+ * @brief The mutex-guarded deque the queues replace, for comparison
+ */
+struct LockedQueue
+{
+    std::mutex mutex;
+    std::deque<uint64_t> values;
+    size_t capacity;
+    std::atomic<uint64_t> dropped = {0};
+
+    LockedQueue(size_t size) : capacity(size) {}
+    void push(uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (values.size() >= capacity)
+        {
+            values.pop_front();
+            ++dropped;
+        }
+        values.push_back(value);
+    }
+    bool pop(uint64_t& value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (values.empty())
+            return false;
+        value = values.front();
+        values.pop_front();
+        return true;
+    }
+    uint64_t getDroppedCount() const { return dropped.load(); }
+};
+
+struct Sample
+{
+    uint64_t sequence;
+    uint64_t check[7]; ///< ~sequence, a torn read shows up as a mismatch
+};
+
+void runMailbox(uint64_t count)
+{
+    Xycar::Mailbox<Sample> mailbox;
+    std::atomic<bool> done(false);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer([&] {
+        for (uint64_t i = 1; i <= count; ++i)
+        {
+            Sample& sample = mailbox.writeBuffer();
+            sample.sequence = i;
+            for (uint64_t& word : sample.check)
+                word = ~i;
+            mailbox.publish();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t reads = 0, last = 0;
+    while (true)
+    {
+        bool finished = done.load(std::memory_order_acquire);
+        if (mailbox.update())
+        {
+            const Sample& sample = mailbox.readBuffer();
+            for (uint64_t word : sample.check)
+                check(word == ~sample.sequence, "mailbox torn value");
+            check(sample.sequence > last, "mailbox went backwards");
+            last = sample.sequence;
+            ++reads;
+        }
+        else if (finished)
+            break;
+    }
+    writer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    check(last == count, "mailbox missed the final value");
+    std::cout << "mailbox: " << count / seconds * 1e-6 << " M/s written, " << reads << " fresh reads" << std::endl;
+}
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    const uint64_t count = argc > 1 ? std::stoull(argv[1]) : 4000000;
+    const size_t capacity = 1024;
+
+    {
+        Xycar::SpscQueue<uint64_t, Xycar::OverflowPolicy::BLOCK> queue(capacity);
+        run("spsc block", queue, 1, count, true);
+    }
+    {
+        Xycar::SpscQueue<uint64_t, Xycar::OverflowPolicy::DROP_NEWEST> queue(capacity);
+        run("spsc drop newest", queue, 1, count, false);
+    }
+    for (uint32_t producers : {2u, 4u})
+    {
+        std::string suffix = " x" + std::to_string(producers);
+        {
+            Xycar::MpscQueue<uint64_t, Xycar::OverflowPolicy::BLOCK> queue(capacity);
+            run("mpsc block" + suffix, queue, producers, count / producers, true);
+        }
+        {
+            Xycar::MpscQueue<uint64_t, Xycar::OverflowPolicy::DROP_NEWEST> queue(capacity);
+            run("mpsc drop newest" + suffix, queue, producers, count / producers, false);
+        }
+        {
+            Xycar::MpscQueue<uint64_t, Xycar::OverflowPolicy::DROP_OLDEST> queue(capacity);
+            run("mpsc drop oldest" + suffix, queue, producers, count / producers, false);
+        }
+        {
+            LockedQueue queue(capacity);
+            run("mutex deque drop oldest" + suffix, queue, producers, count / producers, false);
+        }
+    }
+    runMailbox(count);
+
+    std::cout << (gFailed ? "FAILED" : "all checks passed") << std::endl;
+    return gFailed ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/CameraDetector.hpp"
+#include "sensor_fusion_system/Recorder.hpp"
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <recording> [--show] [--detect <config.yaml>]" << std::endl;
+        return 1;
+    }
+
+    Xycar::RecordReader reader(argv[1]);
+    if (!reader.isOpen())
+    {
+        std::cerr << "Not a recording: " << argv[1] << std::endl;
+        return 1;
+    }
+    bool show = false;
+    std::string detectConfig;
+    for (int32_t i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--show")
+            show = true;
+        else if (arg == "--detect" && i + 1 < argc)
+            detectConfig = argv[++i];
+    }
+
+    // runs the detector of the node on every frame, to compare YOLO settings on the same data
+    Xycar::TaskPool::Ptr taskPool = nullptr;
+    Xycar::CameraDetector<float>::Ptr detector = nullptr;
+    if (!detectConfig.empty())
+    {
+        YAML::Node config = YAML::LoadFile(detectConfig);
+        taskPool = new Xycar::TaskPool(config["TASK_POOL"]["WORKERS"].as<uint32_t>());
+        detector = new Xycar::CameraDetector<float>(config, taskPool);
+        detector->undistortAndDNNConfig();
+    }
+
+    Xycar::Record record;
+    cv::Mat frame;
+    std::vector<float> ranges;
+    float angleMin, angleIncrement;
+    uint64_t firstStamp = 0, lastStamp = 0;
+    uint32_t numFrames = 0, numScans = 0;
+    int64_t decodeTicks = 0;
+    int64_t detectTicks = 0;
+    uint64_t numDetections = 0;
+    double inferenceMs = 0.0;
+
+    while (reader.next(record))
+    {
+        if (firstStamp == 0)
+            firstStamp = record.stamp;
+        lastStamp = std::max(lastStamp, record.stamp);
+
+        int64_t start = cv::getTickCount();
+        if (record.type == Xycar::RecordType::FRAME)
+        {
+            if (Xycar::Recorder::decodeFrame(record.payload, frame))
+                ++numFrames;
+        }
+        else if (record.type == Xycar::RecordType::SCAN)
+        {
+            if (Xycar::Recorder::decodeScan(record.payload, angleMin, angleIncrement, ranges))
+                ++numScans;
+        }
+        decodeTicks += cv::getTickCount() - start;
+
+        if (detector != nullptr && record.type == Xycar::RecordType::FRAME && !frame.empty())
+        {
+            start = cv::getTickCount();
+            detector->undistort(frame);
+            detector->detect();
+            detectTicks += cv::getTickCount() - start;
+            numDetections += detector->getDetections().size();
+            inferenceMs += detector->getInferenceTime();
+        }
+
+        if (show && record.type == Xycar::RecordType::FRAME && !frame.empty())
+        {
+            cv::imshow("replay", frame);
+            cv::waitKey(1);
+        }
+    }
+
+    double recordedSec = (lastStamp - firstStamp) * 1e-9;
+    double decodeSec = decodeTicks / cv::getTickFrequency();
+    std::cout << "frames: " << numFrames << ", scans: " << numScans << std::endl;
+    std::cout << "recorded: " << recordedSec << " s, decoded in: " << decodeSec << " s";
+    if (decodeSec > 0)
+        std::cout << " (" << recordedSec / decodeSec << "x real time)";
+    std::cout << std::endl;
+
+    if (detector != nullptr && numFrames > 0)
+    {
+        std::cout << "detections: " << numDetections << " (" << static_cast<double>(numDetections) / numFrames << " per frame)" << std::endl;
+        std::cout << "detect: " << detectTicks * 1000.0 / cv::getTickFrequency() / numFrames << " ms per frame, network: "
+                  << inferenceMs / numFrames << " ms per frame" << std::endl;
+    }
+
+    delete detector;
+    delete taskPool;
+    return 0;
+}
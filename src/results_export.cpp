@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sensor_fusion_system/ResultsLog.hpp"
+
+// Export of a results log (RESULTS_LOG.PATH) to one CSV file per table: <prefix>_frames.csv,
+// <prefix>_boxes.csv, <prefix>_stages.csv and <prefix>_objects.csv. Blocks are decompressed one at a time and read column
+// by column, so memory stays bounded by the block size whatever the length of the run.
+
+namespace {
+/// Append one value of a column to a CSV line
+void appendValue(std::string& line, Xycar::ColumnType type, const uint8_t* value)
+{
+    char text[32];
+    int32_t length = 0;
+    switch (type)
+    {
+    case Xycar::ColumnType::U8:
+        length = std::snprintf(text, sizeof(text), "%u", static_cast<uint32_t>(*value));
+        break;
+    case Xycar::ColumnType::I32: {
+        int32_t v;
+        std::memcpy(&v, value, sizeof(v));
+        length = std::snprintf(text, sizeof(text), "%d", v);
+        break;
+    }
+    case Xycar::ColumnType::U32: {
+        uint32_t v;
+        std::memcpy(&v, value, sizeof(v));
+        length = std::snprintf(text, sizeof(text), "%u", v);
+        break;
+    }
+    case Xycar::ColumnType::U64: {
+        unsigned long long v;
+        std::memcpy(&v, value, sizeof(uint64_t));
+        length = std::snprintf(text, sizeof(text), "%llu", v);
+        break;
+    }
+    case Xycar::ColumnType::F32: {
+        float v;
+        std::memcpy(&v, value, sizeof(v));
+        length = std::snprintf(text, sizeof(text), "%.6g", v);
+        break;
+    }
+    }
+    line.append(text, length);
+}
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <results log> <output prefix>" << std::endl;
+        return 1;
+    }
+
+    Xycar::ResultsLogReader reader(argv[1]);
+    if (!reader.isOpen())
+    {
+        std::cerr << "Not a results log: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    const std::string prefix = argv[2];
+    std::ofstream frames(prefix + "_frames.csv"), boxes(prefix + "_boxes.csv"), stages(prefix + "_stages.csv"),
+        objects(prefix + "_objects.csv");
+    auto writeHeader = [](std::ofstream& file, Xycar::LogTable table, const char* extra) {
+        Xycar::TableSchema schema = Xycar::getTableSchema(table);
+        for (size_t c = 0; c < schema.numColumns; ++c)
+            file << (c == 0 ? "" : ",") << schema.columns[c].name;
+        file << extra << "\n";
+    };
+    writeHeader(frames, Xycar::LogTable::FRAMES, "");
+    writeHeader(boxes, Xycar::LogTable::BOXES, "");
+    writeHeader(stages, Xycar::LogTable::STAGES, ",stage_name");
+    writeHeader(objects, Xycar::LogTable::OBJECTS, "");
+
+    std::vector<std::string> stageNames;
+    Xycar::LogBlock block;
+    std::string line;
+    uint64_t rows[5] = {};
+    while (reader.next(block))
+    {
+        if (block.table == Xycar::LogTable::STAGE_NAMES)
+        {
+            std::string names(block.data.begin(), block.data.end());
+            for (size_t begin = 0, end; (end = names.find('\n', begin)) != std::string::npos; begin = end + 1)
+                stageNames.push_back(names.substr(begin, end - begin));
+            continue;
+        }
+
+        std::ofstream* const files[] = {nullptr, &frames, &boxes, &stages, &objects};
+        std::ofstream& file = *files[static_cast<uint8_t>(block.table)];
+        Xycar::TableSchema schema = Xycar::getTableSchema(block.table);
+
+        // start of every column in the block
+        std::vector<const uint8_t*> columns(schema.numColumns);
+        const uint8_t* column = block.data.data();
+        for (size_t c = 0; c < schema.numColumns; ++c)
+        {
+            columns[c] = column;
+            column += schema.columns[c].size * block.rows;
+        }
+
+        for (uint32_t r = 0; r < block.rows; ++r)
+        {
+            line.clear();
+            for (size_t c = 0; c < schema.numColumns; ++c)
+            {
+                if (c != 0)
+                    line += ',';
+                appendValue(line, schema.columns[c].type, columns[c] + schema.columns[c].size * r);
+            }
+            if (block.table == Xycar::LogTable::STAGES)
+            {
+                uint32_t stage;
+                std::memcpy(&stage, columns[1] + sizeof(uint32_t) * r, sizeof(stage));
+                line += ',';
+                line += stage < stageNames.size() ? stageNames[stage] : std::string();
+            }
+            line += '\n';
+            file << line;
+        }
+        rows[static_cast<uint8_t>(block.table)] += block.rows;
+    }
+
+    std::cout << rows[1] << " frames, " << rows[2] << " boxes, " << rows[3] << " stage runs, " << rows[4] << " objects exported"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file BatchMovingAverageFilter.cpp
+ * @version 1.0
+ * @date 2024-02-18
+ */
+
+#include <algorithm>
+#include <iostream>
+
+#include "sensor_fusion_system/BatchMovingAverageFilter.hpp"
+
+namespace Xycar {
+
+template <typename PREC, FilteringMode Mode>
+BatchMovingAverageFilter<PREC, Mode>::BatchMovingAverageFilter(uint32_t sampleSize, size_t numInstances)
+    : mSampleSize(std::max<uint32_t>(sampleSize, 1)), mNumInstances(numInstances), mSamples(static_cast<size_t>(mSampleSize) * numInstances, 0),
+      mSums(numInstances, 0), mWeightedSums(numInstances, 0), mFilteringResults(numInstances, 0)
+{
+    if (sampleSize == 0)
+        std::cerr << "Moving average sample size must be at least 1, using 1" << std::endl;
+}
+
+template <typename PREC, FilteringMode Mode>
+void BatchMovingAverageFilter<PREC, Mode>::addSamples(const int32_t* newSamples)
+{
+    const size_t n = mNumInstances;
+    int32_t* __restrict slot = mSamples.data() + static_cast<size_t>(mHead) * n;
+    int32_t* __restrict sums = mSums.data();
+    int32_t* __restrict weightedSums = mWeightedSums.data();
+
+    if (mNumSamples < mSampleSize)
+    {
+        // window still filling, nothing leaves it
+        const int32_t weight = static_cast<int32_t>(++mNumSamples);
+        for (size_t i = 0; i < n; ++i)
+        {
+            int32_t sample = newSamples[i];
+            weightedSums[i] += weight * sample;
+            sums[i] += sample;
+            slot[i] = sample;
+        }
+    }
+    else
+    {
+        const int32_t weight = static_cast<int32_t>(mSampleSize);
+        for (size_t i = 0; i < n; ++i)
+        {
+            int32_t sample = newSamples[i];
+            weightedSums[i] += weight * sample - sums[i];
+            sums[i] += sample - slot[i];
+            slot[i] = sample;
+        }
+    }
+    mHead = (mHead + 1) % mSampleSize;
+
+    const int32_t* __restrict numerators = Mode == FilteringMode::NORMAL ? sums : weightedSums;
+    const PREC denominator = Mode == FilteringMode::NORMAL ? mNumSamples : mNumSamples * (mNumSamples + 1) / 2;
+    const PREC inverse = static_cast<PREC>(1) / denominator;
+    PREC* __restrict results = mFilteringResults.data();
+    for (size_t i = 0; i < n; ++i)
+        results[i] = static_cast<PREC>(numerators[i]) * inverse;
+}
+
+template class BatchMovingAverageFilter<float>;
+template class BatchMovingAverageFilter<double>;
+template class BatchMovingAverageFilter<float, FilteringMode::NORMAL>;
+template class BatchMovingAverageFilter<double, FilteringMode::NORMAL>;
+} // namespace Xycar
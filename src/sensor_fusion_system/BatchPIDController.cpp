@@ -0,0 +1,52 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file BatchPIDController.cpp
+ * @version 1.0
+ * @date 2024-02-18
+ */
+
+#include <algorithm>
+
+#include "sensor_fusion_system/BatchPIDController.hpp"
+
+namespace Xycar {
+
+template <typename PREC>
+BatchPIDController<PREC>::BatchPIDController(const std::vector<PREC>& pGains, const std::vector<PREC>& iGains, const std::vector<PREC>& dGains)
+    : mProportionalGain(pGains), mIntegralGain(iGains), mDifferentialGain(dGains), mProportionalGainError(pGains.size(), 0),
+      mIntegralGainError(pGains.size(), 0)
+{
+}
+
+template <typename PREC>
+void BatchPIDController<PREC>::getControlOutput(const PREC* errors, PREC* outputs)
+{
+    const size_t n = size();
+    const PREC* __restrict proportionalGain = mProportionalGain.data();
+    const PREC* __restrict integralGain = mIntegralGain.data();
+    const PREC* __restrict differentialGain = mDifferentialGain.data();
+    PREC* __restrict previousError = mProportionalGainError.data();
+    PREC* __restrict integralError = mIntegralGainError.data();
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        PREC error = errors[i];
+        PREC differentialError = error - previousError[i];
+        previousError[i] = error;
+        integralError[i] += error;
+        outputs[i] = proportionalGain[i] * error + integralGain[i] * integralError[i] + differentialGain[i] * differentialError;
+    }
+}
+
+template <typename PREC>
+void BatchPIDController<PREC>::reset()
+{
+    std::fill(mProportionalGainError.begin(), mProportionalGainError.end(), 0);
+    std::fill(mIntegralGainError.begin(), mIntegralGainError.end(), 0);
+}
+
+template class BatchPIDController<float>;
+template class BatchPIDController<double>;
+} // namespace Xycar
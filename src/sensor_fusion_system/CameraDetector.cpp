@@ -8,6 +8,9 @@
  * @date 2024-02-06
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <numeric>
 #include "sensor_fusion_system/CameraDetector.hpp"
 
@@ -43,12 +46,38 @@ void CameraDetector<PREC>::setConfiguration(const YAML::Node& config)
     }
     mDistCoeffs = cv::Mat(distMatrixData, true);
 
+    if (config["CAMERA"]["UNDISTORT"].as<std::string>() == "POINTS")
+        mUndistortGrid = new UndistortGrid<PREC>(config["CAMERA"]["UNDISTORT_GRID_CELL"].as<uint32_t>());
+
     mYoloConfig = config["YOLO"]["CONFIG"].as<std::string>();
     mYoloModel = config["YOLO"]["MODEL"].as<std::string>();
     mYoloLabel = config["YOLO"]["LABEL"].as<std::string>();
+    mInputSize = config["YOLO"]["INPUT_SIZE"].as<int32_t>();
+    mTwoStage = config["YOLO"]["TWO_STAGE"]["ENABLE"].as<bool>();
+    mProposalSize = config["YOLO"]["TWO_STAGE"]["PROPOSAL_SIZE"].as<int32_t>();
+    mProposalThreshold = config["YOLO"]["TWO_STAGE"]["PROPOSAL_THRESHOLD"].as<float>();
+    mRefineSize = config["YOLO"]["TWO_STAGE"]["REFINE_SIZE"].as<int32_t>();
+    mCropMargin = config["YOLO"]["TWO_STAGE"]["CROP_MARGIN"].as<float>();
+    mMaxCrops = config["YOLO"]["TWO_STAGE"]["MAX_CROPS"].as<int32_t>();
+    mEmptyCrop = cv::Mat::zeros(mRefineSize, mRefineSize, CV_8UC3);
+
+    if (config["CLASSIFIER"]["ENABLE"].as<bool>())
+        mCropClassifier = new CropClassifier(config["CLASSIFIER"]);
 
     mDebugging = config["DEBUG"].as<bool>();
 
+    if (config["LIDAR"]["PROJECTION_LUT"].as<bool>()) {
+        mProjectionTable = new ProjectionLookupTable<PREC>(config["LIDAR"]["LUT_RANGE_MIN"].as<PREC>(),
+            config["LIDAR"]["LUT_RANGE_MAX"].as<PREC>(), config["LIDAR"]["LUT_RANGE_BINS"].as<uint32_t>());
+    }
+
+    mFrustumCulling = config["LIDAR"]["FRUSTUM_CULLING"].as<bool>();
+    mFrustumRangeMin = config["LIDAR"]["FRUSTUM_RANGE_MIN"].as<PREC>();
+    mFrustumRangeMax = config["LIDAR"]["FRUSTUM_RANGE_MAX"].as<PREC>();
+
+    mGroundHeight = config["GROUND_PLANE"]["HEIGHT"].as<double>();
+    mGroundRangeMax = config["GROUND_PLANE"]["RANGE_MAX"].as<double>();
+
     mLidarRvec = cv::Mat(3, 1, cv::DataType<double>::type);
     mLidarTvec = cv::Mat(3, 1, cv::DataType<double>::type);
     mVCSRvec = cv::Mat(3, 1, cv::DataType<double>::type);
@@ -59,22 +88,17 @@ template <typename PREC>
 void CameraDetector<PREC>::undistortAndDNNConfig()
 {
     cv::initUndistortRectifyMap(mCameraMatrix, mDistCoeffs, cv::Mat(), mCameraMatrix, mImageSize, CV_32FC1, mMap1, mMap2);
-
-    mNeuralNet = cv::dnn::readNetFromDarknet(mYoloConfig, mYoloModel);
-    // mNeuralNet = cv::dnn::readNetFromONNX(mYoloModel);
-
-    // Neural Net setting
-    if(mNeuralNet.empty()){
-        std::cerr << "Network load failed!" << std::endl;
+    if (mCropClassifier != nullptr)
+        mCropClassifier->setUndistortMaps(mMap1, mMap2);
+    if (mUndistortGrid != nullptr) {
+        mUndistortGrid->build(mCameraMatrix, mDistCoeffs, mImageSize);
+        if (mDebugging)
+            std::cout << "undistort grid max error against undistortPoints: " << mUndistortGrid->validate(mCameraMatrix, mDistCoeffs) << " px" << std::endl;
     }
 
-#if 0
-        mNeuralNet.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-        mNeuralNet.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-#else
-        mNeuralNet.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
-        mNeuralNet.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
-#endif
+    mNeuralNet = loadNetwork();
+    if (mTwoStage)
+        mProposalNet = loadNetwork(); // own instance, so neither net reshapes between the two passes
 
     std::ifstream classNamesFile(mYoloLabel);
     if (classNamesFile.is_open()) {
@@ -86,103 +110,295 @@ void CameraDetector<PREC>::undistortAndDNNConfig()
     mOutputLayers = mNeuralNet.getUnconnectedOutLayersNames();
 }
 
+template <typename PREC>
+cv::dnn::Net CameraDetector<PREC>::loadNetwork() const
+{
+    cv::dnn::Net net = cv::dnn::readNetFromDarknet(mYoloConfig, mYoloModel);
+    // cv::dnn::Net net = cv::dnn::readNetFromONNX(mYoloModel);
+
+    // Neural Net setting
+    if(net.empty()){
+        std::cerr << "Network load failed!" << std::endl;
+    }
+
+#if 0
+        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+#else
+        net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+        net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+#endif
+    return net;
+}
+
 template <typename PREC>
 std::vector<int> CameraDetector<PREC>::boundingBox(const cv::Mat img, const std::vector<cv::Point2f> lidarImagePoints)
 {
     std::vector<int> objectIdx;
+    mDetections.clear();
 
     if (img.empty()) {
         // std::cerr << "No image.. Wait.." << std::endl;
+        return objectIdx;
     }
-    else {
-        // undistort image
-        mTemp = img.clone();
-        cv::remap(img, mTemp, mMap1, mMap2, cv::INTER_LINEAR);
 
-        // Convert Mat to batch of images
-        cv::Mat blob = cv::dnn::blobFromImage(mTemp, 1 / 255.f, cv::Size(416, 416), cv::Scalar(), true);
+    undistort(img);
+    detect();
+    associate(lidarImagePoints);
+    draw(lidarImagePoints);
+    show();
+
+    for (const Detection& detection : mDetections)
+        objectIdx.insert(objectIdx.end(), detection.pointIndices.begin(), detection.pointIndices.end());
+    return objectIdx;
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::undistort(const cv::Mat& img)
+{
+    // POINTS mode, the boxes are undistorted after detection. Still a copy, the debug frame is drawn on
+    if (mUndistortGrid != nullptr) {
+        img.copyTo(mTemp);
+        return;
+    }
+    mTemp = img.clone();
+    cv::remap(img, mTemp, mMap1, mMap2, cv::INTER_LINEAR);
+}
 
-        // Set the network input
-        mNeuralNet.setInput(blob);
+template <typename PREC>
+void CameraDetector<PREC>::detect()
+{
+    mDetections.clear();
+    mInferenceTime = 0.0;
+
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+    std::vector<cv::Rect> boxes;
+    const cv::Rect frameRegion(0, 0, mTemp.cols, mTemp.rows);
 
-        // compute output
+    if (!mTwoStage) {
+        // Convert Mat to batch of images
+        cv::Mat blob = cv::dnn::blobFromImage(mTemp, 1 / 255.f, cv::Size(mInputSize, mInputSize), cv::Scalar(), true);
         std::vector<cv::Mat> outs;
-        mNeuralNet.forward(outs, mOutputLayers);
-
-        std::vector<double> layersTimings;
-        double time_ms = mNeuralNet.getPerfProfile(layersTimings) * 1000 / cv::getTickFrequency();
-        putText(mTemp, cv::format("FPS: %.2f ; time: %.2f ms", 1000.f / time_ms, time_ms),
-            cv::Point(20, 30), 0, 0.75, cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
-
-        std::vector<int> classIds;
-        std::vector<float> confidences;
-        std::vector<cv::Rect> boxes;
-
-        for (auto& out : outs) {
-            float* data = (float*)out.data;
-            for (int j = 0; j < out.rows; ++j, data += out.cols) {
-                cv::Mat scores = out.row(j).colRange(5, out.cols);
-                double confidence;
-                cv::Point classIdPoint;
-
-                minMaxLoc(scores, 0, &confidence, 0, &classIdPoint);
-
-                if (confidence > mConfThreshold && classIdPoint.x == 4) {
-                    int cx = static_cast<int>(data[0] * mTemp.cols);
-                    int cy = static_cast<int>(data[1] * mTemp.rows);
-                    int bw = static_cast<int>(data[2] * mTemp.cols);
-                    int bh = static_cast<int>(data[3] * mTemp.rows);
-                    int sx = cx - bw / 2;
-                    int sy = cy - bh / 2;
-
-                    classIds.push_back(classIdPoint.x);
-                    confidences.push_back((float)confidence);
-                    boxes.push_back(cv::Rect(sx, sy, bw, bh));
-                }
+        forward(mNeuralNet, blob, outs);
+        decode(outs, {frameRegion}, mConfThreshold, classIds, confidences, boxes);
+    }
+    else {
+        // cheap pass over the whole frame with a low threshold, only to find where to look
+        cv::Mat blob = cv::dnn::blobFromImage(mTemp, 1 / 255.f, cv::Size(mProposalSize, mProposalSize), cv::Scalar(), true);
+        std::vector<cv::Mat> outs;
+        forward(mProposalNet, blob, outs);
+
+        std::vector<int> proposalClassIds;
+        std::vector<float> proposalConfidences;
+        std::vector<cv::Rect> proposalBoxes;
+        decode(outs, {frameRegion}, mProposalThreshold, proposalClassIds, proposalConfidences, proposalBoxes);
+
+        // NMS keeps the indices sorted by confidence, the strongest proposals get the crops
+        std::vector<int> proposals;
+        cv::dnn::NMSBoxes(proposalBoxes, proposalConfidences, mProposalThreshold, mNmsThreshold, proposals);
+        if (proposals.size() > static_cast<size_t>(mMaxCrops))
+            proposals.resize(mMaxCrops);
+
+        if (!proposals.empty()) {
+            // square native resolution crops around each proposal, shifted inside the frame
+            std::vector<cv::Rect> regions;
+            std::vector<cv::Mat> crops;
+            for (int idx : proposals) {
+                const cv::Rect& box = proposalBoxes[idx];
+                int side = std::max(mRefineSize, static_cast<int>(std::max(box.width, box.height) * (1.f + 2.f * mCropMargin)));
+                side = std::min(side, std::min(mTemp.cols, mTemp.rows));
+                int x = std::min(std::max(box.x + box.width / 2 - side / 2, 0), mTemp.cols - side);
+                int y = std::min(std::max(box.y + box.height / 2 - side / 2, 0), mTemp.rows - side);
+                regions.emplace_back(x, y, side, side);
+                crops.push_back(mTemp(regions.back()));
             }
+
+            // always a full batch, so the network keeps one input shape; the padding crops are never decoded
+            while (crops.size() < static_cast<size_t>(mMaxCrops))
+                crops.push_back(mEmptyCrop);
+
+            blob = cv::dnn::blobFromImages(crops, 1 / 255.f, cv::Size(mRefineSize, mRefineSize), cv::Scalar(), true);
+            forward(mNeuralNet, blob, outs);
+            decode(outs, regions, mConfThreshold, classIds, confidences, boxes);
         }
+    }
+
+    std::vector<int> indices;
+    cv::dnn::NMSBoxes(boxes, confidences, mConfThreshold, mNmsThreshold, indices);
 
-        std::vector<int> indices;
-        cv::dnn::NMSBoxes(boxes, confidences, mConfThreshold, mNmsThreshold, indices);
+    mDetections.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        mDetections[i].frameBox = boxes[indices[i]];
+        mDetections[i].box = mUndistortGrid != nullptr ? undistortBox(boxes[indices[i]]) : boxes[indices[i]];
+        mDetections[i].classId = classIds[indices[i]];
+        mDetections[i].confidence = confidences[indices[i]];
+    }
+}
 
-        for (size_t i = 0; i < indices.size(); ++i) {
-            int idx = indices[i];
-            int sx = boxes[idx].x;
-            int sy = boxes[idx].y;
-            int width = boxes[idx].width;
-            int height = boxes[idx].height;
+template <typename PREC>
+cv::Rect CameraDetector<PREC>::undistortBox(const cv::Rect& box) const
+{
+    // straight edges of a raw box bend after undistortion, so the edge midpoints bound it with the corners
+    const float x0 = box.x, x1 = box.x + box.width, xm = (x0 + x1) / 2;
+    const float y0 = box.y, y1 = box.y + box.height, ym = (y0 + y1) / 2;
+    const cv::Point2f outline[] = {{x0, y0}, {xm, y0}, {x1, y0}, {x1, ym}, {x1, y1}, {xm, y1}, {x0, y1}, {x0, ym}};
+
+    float left = std::numeric_limits<float>::max(), top = left, right = -left, bottom = -left;
+    for (const cv::Point2f& point : outline) {
+        cv::Point2f undistorted = mUndistortGrid->undistort(point);
+        left = std::min(left, undistorted.x);
+        right = std::max(right, undistorted.x);
+        top = std::min(top, undistorted.y);
+        bottom = std::max(bottom, undistorted.y);
+    }
+    cv::Rect undistortedBox(cv::Point(std::lround(left), std::lround(top)), cv::Point(std::lround(right), std::lround(bottom)));
+    return undistortedBox & cv::Rect(0, 0, mImageWidth, mImageHeight);
+}
 
-            rectangle(mTemp, boxes[idx], cv::Scalar(0, 255, 0));
+template <typename PREC>
+void CameraDetector<PREC>::classify(const cv::Mat& img)
+{
+    if (mCropClassifier == nullptr || mDetections.empty())
+        return;
+
+    std::vector<cv::Rect> boxes;
+    std::vector<int32_t> detectorClassIds;
+    for (const Detection& detection : mDetections) {
+        boxes.push_back(detection.box);
+        detectorClassIds.push_back(detection.classId);
+    }
 
-            std::string label = cv::format("%.2f", confidences[idx]);
-            label = mClassNames[classIds[idx]] + ":" + label;
-            int baseLine = 0;
-            cv::Size labelSize = getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
-            rectangle(mTemp, cv::Rect(sx, sy, labelSize.width, labelSize.height + baseLine), cv::Scalar(0, 255, 0), cv::FILLED);
-            putText(mTemp, label, cv::Point(sx, sy + labelSize.height), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(), 1, cv::LINE_AA);
+    std::vector<int32_t> classIds;
+    std::vector<float> confidences;
+    mCropClassifier->classify(img, boxes, detectorClassIds, classIds, confidences);
+    for (size_t i = 0; i < mDetections.size(); ++i) {
+        mDetections[i].subClassId = classIds[i];
+        mDetections[i].subConfidence = confidences[i];
+    }
+}
 
-            int number = 0;
-            std::cout << "number of bbox indexes start!!!!!" << std::endl;
-            for (size_t i = 0; i < lidarImagePoints.size(); ++i) {
-                int u = lidarImagePoints[i].x;
-                int v = lidarImagePoints[i].y;
+template <typename PREC>
+void CameraDetector<PREC>::forward(cv::dnn::Net& net, const cv::Mat& blob, std::vector<cv::Mat>& outs)
+{
+    // Set the network input
+    net.setInput(blob);
 
-                if (u < sx || u > sx + width || v < sy || v > sy + height)
-                    continue;
+    // compute output
+    net.forward(outs, mOutputLayers);
 
-                circle(mTemp, cv::Point(u, v), 1, cv::Scalar(0, 0, 255), 2, cv::LINE_AA);
-                objectIdx.push_back(i);
+    std::vector<double> layersTimings;
+    mInferenceTime += net.getPerfProfile(layersTimings) * 1000 / cv::getTickFrequency();
+}
 
-                ++number;
-                std::cout << "number of bbox indexes: " << number << std::endl;
+template <typename PREC>
+void CameraDetector<PREC>::decode(const std::vector<cv::Mat>& outs, const std::vector<cv::Rect>& regions, float threshold,
+                                  std::vector<int>& classIds, std::vector<float>& confidences, std::vector<cv::Rect>& boxes)
+{
+    // one task per (layer, batch item), concatenated in that order so NMS sees the same input every run.
+    // A batched region layer output is [batch, cells, 5 + classes], a single image one [cells, 5 + classes]
+    const size_t numTasks = outs.size() * regions.size();
+    std::vector<std::vector<int>> taskClassIds(numTasks);
+    std::vector<std::vector<float>> taskConfidences(numTasks);
+    std::vector<std::vector<cv::Rect>> taskBoxes(numTasks);
+    mTaskPool->parallelFor(numTasks, [&](size_t task) {
+        const cv::Mat& out = outs[task / regions.size()];
+        const size_t item = task % regions.size();
+        const cv::Rect& region = regions[item];
+        const int rows = out.dims == 3 ? out.size[1] : out.rows;
+        const int cols = out.dims == 3 ? out.size[2] : out.cols;
+        const float* data = (const float*)out.data + item * rows * cols;
+        for (int j = 0; j < rows; ++j, data += cols) {
+            const float* scores = data + 5;
+            const int classId = static_cast<int>(std::max_element(scores, data + cols) - scores);
+            const float confidence = scores[classId];
+
+            if (confidence > threshold && classId == 4) {
+                // normalized to the region the network saw
+                int cx = region.x + static_cast<int>(data[0] * region.width);
+                int cy = region.y + static_cast<int>(data[1] * region.height);
+                int bw = static_cast<int>(data[2] * region.width);
+                int bh = static_cast<int>(data[3] * region.height);
+                int sx = cx - bw / 2;
+                int sy = cy - bh / 2;
+
+                taskClassIds[task].push_back(classId);
+                taskConfidences[task].push_back(confidence);
+                taskBoxes[task].push_back(cv::Rect(sx, sy, bw, bh));
             }
         }
+    });
+
+    for (size_t t = 0; t < numTasks; ++t) {
+        classIds.insert(classIds.end(), taskClassIds[t].begin(), taskClassIds[t].end());
+        confidences.insert(confidences.end(), taskConfidences[t].begin(), taskConfidences[t].end());
+        boxes.insert(boxes.end(), taskBoxes[t].begin(), taskBoxes[t].end());
+    }
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::associate(const std::vector<cv::Point2f>& lidarImagePoints)
+{
+    associate(lidarImagePoints, mDetections);
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::associate(const std::vector<cv::Point2f>& lidarImagePoints, std::vector<Detection>& detections) const
+{
+    // box by box in parallel, each box only writes its own detection
+    mTaskPool->parallelFor(detections.size(), [&](size_t i) {
+        Detection& detection = detections[i];
+        const cv::Rect& box = detection.box;
+        detection.pointIndices.clear();
+
+        for (size_t p = 0; p < lidarImagePoints.size(); ++p) {
+            int u = lidarImagePoints[p].x;
+            int v = lidarImagePoints[p].y;
+
+            if (u < box.x || u > box.x + box.width || v < box.y || v > box.y + box.height)
+                continue;
+            detection.pointIndices.push_back(p);
+        }
+    });
+}
 
+template <typename PREC>
+void CameraDetector<PREC>::draw(const std::vector<cv::Point2f>& lidarImagePoints)
+{
+    putText(mTemp, cv::format("FPS: %.2f ; time: %.2f ms", 1000.f / mInferenceTime, mInferenceTime),
+        cv::Point(20, 30), 0, 0.75, cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
+
+    // drawing shares the frame, keep it serial and in NMS order. The frame is raw in POINTS mode, so the
+    // boxes are drawn as detected rather than undistorted
+    for (const Detection& detection : mDetections) {
+        int sx = detection.frameBox.x;
+        int sy = detection.frameBox.y;
+
+        rectangle(mTemp, detection.frameBox, cv::Scalar(0, 255, 0));
+
+        std::string label = cv::format("%.2f", detection.confidence);
+        label = mClassNames[detection.classId] + ":" + label;
+        if (detection.subClassId >= 0)
+            label += " " + mCropClassifier->getClassName(detection.subClassId) + cv::format(":%.2f", detection.subConfidence);
+        int baseLine = 0;
+        cv::Size labelSize = getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+        rectangle(mTemp, cv::Rect(sx, sy, labelSize.width, labelSize.height + baseLine), cv::Scalar(0, 255, 0), cv::FILLED);
+        putText(mTemp, label, cv::Point(sx, sy + labelSize.height), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(), 1, cv::LINE_AA);
+
+        if (mDebugging)
+            std::cout << "number of bbox indexes: " << detection.pointIndices.size() << std::endl;
+        for (int idx : detection.pointIndices)
+            circle(mTemp, cv::Point(lidarImagePoints[idx].x, lidarImagePoints[idx].y), 1, cv::Scalar(0, 0, 255), 2, cv::LINE_AA);
+    }
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::show() const
+{
+    if (mDebugging) {
         cv::imshow("undistort_img", mTemp);
         cv::waitKey(1);
     }
-
-    return objectIdx;
 }
 
 template <typename PREC>
@@ -199,6 +415,13 @@ void CameraDetector<PREC>::getLidarExtrinsicMatrix(std::vector<cv::Point2f> imag
     mLidarTvec.copyTo(mLidarExtrinsicMatrix(cv::Rect(3, 0, 1, 3)));
     mLidarExtrinsicMatrix.at<double>(3, 3) = 1.0;
 
+    // new calibration, the table and the visible beams have to be projected again
+    if (mProjectionTable != nullptr) {
+        mProjectionTable->invalidate();
+        updateProjectionTable();
+    }
+    updateVisibleBeams();
+
     // cv::Mat point3D = (cv::Mat_<double>(4, 1) << 0.887527, -0.105, 1.33728, 1); // 3D 포인트, 1); // 3D 포인트
     // cv::Mat pointInCamera = mLidarExtrinsicMatrix * point3D; // 카메라 좌표계로 변환
 
@@ -227,6 +450,12 @@ void CameraDetector<PREC>::getVCSExtrinsicMatrix(std::vector<cv::Point2f> imageP
     mVCSTvec.copyTo(mVCSExtrinsicMatrix(cv::Rect(3, 0, 1, 3)));
     mVCSExtrinsicMatrix.at<double>(3, 3) = 1.0;
 
+    // detections live in the undistorted image, whose camera matrix is mCameraMatrix again
+    cv::Matx33d K = mCameraMatrix;
+    cv::Matx33d Rt = cv::Matx33d(R).t();
+    mGroundRayMatrix = Rt * K.inv();
+    mCameraCenter = (Rt * cv::Matx31d(mVCSTvec)) * -1.0;
+
     cv::Mat point3D1 = (cv::Mat_<double>(4, 1) << 0.887527, -0.105, 1.33728, 1); // 3D 포인트, 1); // 3D 포인트
     cv::Mat pointInCamera1 = mLidarExtrinsicMatrix * point3D1; // 카메라 좌표계로 변환
 
@@ -243,9 +472,7 @@ void CameraDetector<PREC>::getVCSExtrinsicMatrix(std::vector<cv::Point2f> imageP
     double y = pointInCamera1.at<double>(1, 0);
     double z = pointInCamera1.at<double>(2, 0);
     std::cout << "x,y,z, mat size: " << x << ", " << y << ", "<< z << ", " << pointInCamera1.size() << std::endl;
-    cv::Mat pointInCamera1_conv = (cv::Mat_<double>(4, 1) << -x, -y, -z, 1); // 3D 포인트
-
-    cv::Mat pointInVCS = VCSExtrinsicMatrixInv * pointInCamera1_conv;//mLidarExtrinsicMatrix * point3D1; // 카메라 좌표계로 변환
+    cv::Mat pointInVCS = VCSExtrinsicMatrixInv * pointInCamera1; // 카메라 좌표계로 변환
 
     std::cout << "from Lidar to VCS coordinate: \n" << pointInVCS << std::endl;
 
@@ -298,6 +525,138 @@ std::vector<cv::Point2f> CameraDetector<PREC>::getProjectPoints(std::vector<cv::
     return filteredPoints;
 }
 
+template <typename PREC>
+std::vector<cv::Point2f> CameraDetector<PREC>::getProjectPoints(std::vector<cv::Point3f>& objectPoints, std::vector<int>& beamIndices, std::vector<float>& ranges){
+    std::vector<cv::Point2f> points(objectPoints.size(), ProjectionLookupTable<PREC>::kInvalidPoint);
+
+    if (mProjectionTable != nullptr && mProjectionTable->isBuiltFor(mScanAngleMin, mScanAngleIncrement, mScanNumBeams)) {
+        // table lookups, only ranges the table does not cover fall back to exact projection
+        std::vector<int> exactIdx;
+        std::vector<cv::Point3f> exactObjectPoints;
+        for (int i=0; i<objectPoints.size(); ++i) {
+            if (mProjectionTable->covers(ranges[i])) {
+                mProjectionTable->lookup(beamIndices[i], ranges[i], points[i]);
+            } else {
+                exactIdx.push_back(i);
+                exactObjectPoints.push_back(objectPoints[i]);
+            }
+        }
+
+        if (!exactObjectPoints.empty()) {
+            std::vector<cv::Point2f> exactPoints;
+            cv::projectPoints(exactObjectPoints, mLidarRvec, mLidarTvec, mCameraMatrix, mDistCoeffs, exactPoints);
+            for (int i=0; i<exactIdx.size(); ++i) {
+                points[exactIdx[i]] = exactPoints[i];
+            }
+        }
+    } else {
+        cv::projectPoints(objectPoints, mLidarRvec, mLidarTvec, mCameraMatrix, mDistCoeffs, points);
+    }
+
+    // keep objectPoints, beamIndices and ranges aligned with the returned image points
+    std::vector<cv::Point2f> filteredPoints;
+    int kept = 0;
+    for (int i=0; i<points.size(); ++i) {
+        double x = points[i].x;
+        double y = points[i].y;
+
+        if (x > 0 && x < mImageWidth && y > 0 && y < mImageHeight) {
+            filteredPoints.push_back(points[i]);
+            objectPoints[kept] = objectPoints[i];
+            beamIndices[kept] = beamIndices[i];
+            ranges[kept] = ranges[i];
+            ++kept;
+        }
+    }
+    objectPoints.resize(kept);
+    beamIndices.resize(kept);
+    ranges.resize(kept);
+
+    return filteredPoints;
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::setScanGeometry(PREC angleMin, PREC angleIncrement, uint32_t numBeams){
+    if (angleMin == mScanAngleMin && angleIncrement == mScanAngleIncrement && numBeams == mScanNumBeams)
+        return;
+
+    mScanAngleMin = angleMin;
+    mScanAngleIncrement = angleIncrement;
+    mScanNumBeams = numBeams;
+    updateProjectionTable();
+    updateVisibleBeams();
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::updateProjectionTable(){
+    if (mProjectionTable == nullptr || mScanNumBeams == 0 || mLidarExtrinsicMatrix.empty())
+        return;
+    if (mProjectionTable->isBuiltFor(mScanAngleMin, mScanAngleIncrement, mScanNumBeams))
+        return;
+
+    mProjectionTable->build(mScanAngleMin, mScanAngleIncrement, mScanNumBeams, &CameraDetector::toLidarObjectPoint,
+        mLidarRvec, mLidarTvec, mCameraMatrix, mDistCoeffs);
+
+    if (mDebugging) {
+        PREC maxError = mProjectionTable->validate(&CameraDetector::toLidarObjectPoint, mLidarRvec, mLidarTvec, mCameraMatrix, mDistCoeffs);
+        std::cout << "projection table rebuilt for " << mScanNumBeams << " beams, max error against projectPoints: " << maxError << " px" << std::endl;
+    }
+}
+
+template <typename PREC>
+void CameraDetector<PREC>::updateVisibleBeams(){
+    mVisibleBeams.clear();
+    if (!mFrustumCulling || mScanNumBeams == 0 || mLidarExtrinsicMatrix.empty())
+        return;
+
+    // sample every beam along the whole usable range and keep it if any sample lands in the image
+    constexpr int kRangeSamples = 128;
+    std::vector<cv::Point3f> objectPoints;
+    objectPoints.reserve(static_cast<size_t>(mScanNumBeams) * kRangeSamples);
+    for (uint32_t beam = 0; beam < mScanNumBeams; ++beam) {
+        PREC angle = mScanAngleMin + static_cast<PREC>(beam) * mScanAngleIncrement;
+        for (int k = 0; k < kRangeSamples; ++k) {
+            PREC range = mFrustumRangeMin + (mFrustumRangeMax - mFrustumRangeMin) * k / (kRangeSamples - 1);
+            objectPoints.push_back(toLidarObjectPoint(angle, range));
+        }
+    }
+
+    std::vector<cv::Point2f> points;
+    cv::projectPoints(objectPoints, mLidarRvec, mLidarTvec, mCameraMatrix, mDistCoeffs, points);
+
+    cv::Matx33d R;
+    cv::Rodrigues(mLidarRvec, R);
+    double tz = mLidarTvec.at<double>(2, 0);
+
+    std::vector<bool> visible(mScanNumBeams, false);
+    for (size_t i = 0; i < points.size(); ++i) {
+        const cv::Point3f& p = objectPoints[i];
+        double zc = R(2, 0) * p.x + R(2, 1) * p.y + R(2, 2) * p.z + tz;
+        if (zc > 0 && points[i].x > 0 && points[i].x < mImageWidth && points[i].y > 0 && points[i].y < mImageHeight)
+            visible[i / kRangeSamples] = true;
+    }
+
+    // one beam of margin on each side so sampling never clips the border of the frustum
+    for (int beam = 0; beam < static_cast<int>(mScanNumBeams); ++beam) {
+        bool prev = beam > 0 && visible[beam - 1];
+        bool next = beam + 1 < static_cast<int>(mScanNumBeams) && visible[beam + 1];
+        if (visible[beam] || prev || next)
+            mVisibleBeams.push_back(beam);
+    }
+
+    if (mDebugging) {
+        std::cout << "frustum culling keeps " << mVisibleBeams.size() << " of " << mScanNumBeams << " beams" << std::endl;
+    }
+}
+
+template <typename PREC>
+cv::Point3f CameraDetector<PREC>::toLidarObjectPoint(PREC angle, PREC range){
+    float x = range * std::cos(angle);
+    float y = range * std::sin(angle);
+
+    return cv::Point3f(y, kLidarPlaneY, -x);
+}
+
 template <typename PREC>
 cv::Point3f CameraDetector<PREC>::getVCSCoordPointsFromLidar(cv::Point3f objectPoint){
     // std::cout << "getVCSCoordPointsFromLidar : " << objectPoint << std::endl;
@@ -306,20 +665,41 @@ cv::Point3f CameraDetector<PREC>::getVCSCoordPointsFromLidar(cv::Point3f objectP
 
     cv::Mat point3D = (cv::Mat_<double>(4, 1) << objectPoint.x, objectPoint.y, objectPoint.z, 1); // 3D 포인트
 
+    // camera point, then R^T (p - t) into the VCS calibration frame. Same frame and axis swap as
+    // getGroundPoint, so lidar and ground-plane positions can be mixed
     cv::Mat pointInCamera = mLidarExtrinsicMatrix * point3D;
-    double xc = pointInCamera.at<double>(0, 0);
-    double yc = pointInCamera.at<double>(1, 0);
-    double zc = pointInCamera.at<double>(2, 0);
-    cv::Mat pointInCamera_conv = (cv::Mat_<double>(4, 1) << -xc, -yc, -zc, 1);
-
-    cv::Mat pointInVCS = VCSExtrinsicMatrixInv * pointInCamera_conv; // convert to VCS coordinates
+    cv::Mat pointInVCS = VCSExtrinsicMatrixInv * pointInCamera; // convert to VCS coordinates
     double xv = pointInVCS.at<double>(0, 0);
     double yv = pointInVCS.at<double>(1, 0);
     double zv = pointInVCS.at<double>(2, 0);
 
+    // calibration frame (x right, y down, z forward) to VCS (x forward, y left, z up)
     return cv::Point3f(zv, -xv, -yv);
 }
 
+template <typename PREC>
+bool CameraDetector<PREC>::getGroundPoint(const cv::Rect& box, cv::Point3f& vcs) const
+{
+    // the bottom edge of a box is where the object touches the ground. If the box is cut by the
+    // image border the real contact is lower, so the estimate is an upper bound
+    cv::Vec3d ray = mGroundRayMatrix * cv::Vec3d(box.x + box.width * 0.5, box.y + box.height, 1.0);
+    if (ray(1) <= 1e-9)
+        return false; // at or above the horizon
+
+    double scale = (mGroundHeight - mCameraCenter(1)) / ray(1);
+    if (scale <= 0)
+        return false;
+
+    double x = mCameraCenter(0) + scale * ray(0);
+    double z = mCameraCenter(2) + scale * ray(2);
+    if (std::hypot(x, z) > mGroundRangeMax)
+        return false;
+
+    // calibration frame (x right, y down, z forward) to VCS (x forward, y left, z up)
+    vcs = cv::Point3f(z, -x, -mGroundHeight);
+    return true;
+}
+
 template <typename PREC>
 std::vector<cv::Point2f> CameraDetector<PREC>::Generate2DPoints()
 {
@@ -0,0 +1,110 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file CropClassifier.cpp
+ * @version 1.0
+ * @date 2024-02-23
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "sensor_fusion_system/CropClassifier.hpp"
+
+namespace Xycar {
+
+CropClassifier::CropClassifier(const YAML::Node& config)
+{
+    mInputSize = config["INPUT_SIZE"].as<int32_t>();
+    mScale = config["SCALE"].as<double>();
+    std::vector<double> mean = config["MEAN"].as<std::vector<double>>();
+    mMean = cv::Scalar(mean[0], mean[1], mean[2]);
+    mSwapRB = config["SWAP_RB"].as<bool>();
+    mSoftmax = config["SOFTMAX"].as<bool>();
+    mBatchSize = config["BATCH_SIZE"].as<int32_t>();
+    mDetectorClasses = config["DETECTOR_CLASSES"].as<std::vector<int32_t>>();
+    mEmptyCrop = cv::Mat::zeros(mInputSize, mInputSize, CV_8UC3);
+
+    mNet = cv::dnn::readNet(config["MODEL"].as<std::string>());
+    if (mNet.empty())
+        std::cerr << "Classifier load failed!" << std::endl;
+#if 0
+    mNet.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    mNet.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+#else
+    mNet.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+    mNet.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+#endif
+
+    std::ifstream classNamesFile(config["LABEL"].as<std::string>());
+    std::string className;
+    while (std::getline(classNamesFile, className))
+        mClassNames.emplace_back(className);
+}
+
+void CropClassifier::setUndistortMaps(const cv::Mat& map1, const cv::Mat& map2)
+{
+    mMap1 = map1;
+    mMap2 = map2;
+}
+
+bool CropClassifier::isRefined(int32_t detectorClassId) const
+{
+    return mDetectorClasses.empty() || std::find(mDetectorClasses.begin(), mDetectorClasses.end(), detectorClassId) != mDetectorClasses.end();
+}
+
+void CropClassifier::classify(const cv::Mat& raw, const std::vector<cv::Rect>& boxes, const std::vector<int32_t>& detectorClassIds,
+                              std::vector<int32_t>& classIds, std::vector<float>& confidences)
+{
+    classIds.assign(boxes.size(), -1);
+    confidences.assign(boxes.size(), 0.f);
+    if (raw.empty() || mMap1.empty())
+        return;
+
+    // boxes come in NMS order, so the batch holds the most confident ones
+    const cv::Rect image(0, 0, mMap1.cols, mMap1.rows);
+    std::vector<size_t> batchBoxes;
+    mCrops.resize(mBatchSize);
+    for (size_t i = 0; i < boxes.size() && batchBoxes.size() < static_cast<size_t>(mBatchSize); ++i)
+    {
+        cv::Rect box = boxes[i] & image;
+        if (box.empty() || !isRefined(detectorClassIds[i]))
+            continue;
+
+        // the maps are smooth, resizing them is the same as evaluating them on the crop grid
+        cv::resize(mMap1(box), mCropMap1, cv::Size(mInputSize, mInputSize), 0, 0, cv::INTER_LINEAR);
+        cv::resize(mMap2(box), mCropMap2, cv::Size(mInputSize, mInputSize), 0, 0, cv::INTER_LINEAR);
+        cv::remap(raw, mCrops[batchBoxes.size()], mCropMap1, mCropMap2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+        batchBoxes.push_back(i);
+    }
+    if (batchBoxes.empty())
+        return;
+
+    // always a full batch, so the network keeps one input shape. The crop buffers stay owned by their slot
+    std::vector<cv::Mat> batch(mCrops.begin(), mCrops.begin() + batchBoxes.size());
+    batch.resize(mBatchSize, mEmptyCrop);
+
+    cv::Mat blob = cv::dnn::blobFromImages(batch, mScale, cv::Size(mInputSize, mInputSize), mMean, mSwapRB);
+    mNet.setInput(blob);
+    cv::Mat scores = mNet.forward().reshape(1, mBatchSize);
+
+    for (size_t b = 0; b < batchBoxes.size(); ++b)
+    {
+        const float* row = scores.ptr<float>(static_cast<int>(b));
+        const int32_t classId = static_cast<int32_t>(std::max_element(row, row + scores.cols) - row);
+        float confidence = row[classId];
+        if (mSoftmax)
+        {
+            double sum = 0.0;
+            for (int32_t c = 0; c < scores.cols; ++c)
+                sum += std::exp(row[c] - row[classId]);
+            confidence = static_cast<float>(1.0 / sum);
+        }
+        classIds[batchBoxes[b]] = classId;
+        confidences[batchBoxes[b]] = confidence;
+    }
+}
+} // namespace Xycar
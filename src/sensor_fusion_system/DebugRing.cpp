@@ -0,0 +1,169 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file DebugRing.cpp
+ * @version 1.0
+ * @date 2024-02-15
+ */
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sensor_fusion_system/DebugRing.hpp"
+
+namespace Xycar {
+namespace {
+constexpr size_t kCacheLine = 64;
+
+inline size_t alignToCacheLine(size_t size) { return (size + kCacheLine - 1) / kCacheLine * kCacheLine; }
+} // namespace
+
+DebugRing::DebugRing(const std::string& name, uint32_t numSlots, uint32_t width, uint32_t height) : mName(name), mOwner(true)
+{
+    uint64_t slotSize = alignToCacheLine(sizeof(DebugRingSlot) + static_cast<size_t>(width) * height * 3);
+    mMappedSize = alignToCacheLine(sizeof(DebugRingHeader)) + slotSize * numSlots;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(mMappedSize)) != 0)
+    {
+        std::cerr << "Debug ring could not create " << name << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    void* mapping = mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Debug ring could not map " << name << std::endl;
+        return;
+    }
+
+    std::memset(mapping, 0, mMappedSize);
+    mHeader = static_cast<DebugRingHeader*>(mapping);
+    mHeader->numSlots = numSlots;
+    mHeader->width = width;
+    mHeader->height = height;
+    mHeader->slotSize = slotSize;
+    mHeader->writeCount.store(0, std::memory_order_relaxed);
+    mHeader->viewerHeartbeat.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mHeader->magic = kDebugRingMagic;
+}
+
+DebugRing::DebugRing(const std::string& name) : mName(name), mOwner(false)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(DebugRingHeader)))
+    {
+        close(fd);
+        return;
+    }
+
+    mMappedSize = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return;
+
+    mHeader = static_cast<DebugRingHeader*>(mapping);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (mHeader->magic != kDebugRingMagic)
+    {
+        munmap(mapping, mMappedSize);
+        mHeader = nullptr;
+    }
+}
+
+DebugRing::~DebugRing()
+{
+    if (mHeader != nullptr)
+        munmap(mHeader, mMappedSize);
+    if (mOwner)
+        shm_unlink(mName.c_str());
+}
+
+bool DebugRing::write(const cv::Mat& frame, const DebugResult& result)
+{
+    if (mHeader == nullptr || frame.type() != CV_8UC3 || frame.cols != static_cast<int>(mHeader->width) ||
+        frame.rows != static_cast<int>(mHeader->height))
+        return false;
+
+    // nobody is watching, skip the copy entirely
+    if (now() - mHeader->viewerHeartbeat.load(std::memory_order_relaxed) > kViewerTimeoutNs)
+        return false;
+
+    uint64_t index = mHeader->writeCount.load(std::memory_order_relaxed);
+    DebugRingSlot* slot = getSlot(index);
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(&slot->result, &result, sizeof(DebugResult));
+    uint8_t* pixels = reinterpret_cast<uint8_t*>(slot + 1);
+    const size_t rowBytes = static_cast<size_t>(frame.cols) * 3;
+    for (int row = 0; row < frame.rows; ++row)
+        std::memcpy(pixels + row * rowBytes, frame.ptr(row), rowBytes);
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    mHeader->writeCount.store(index + 1, std::memory_order_release);
+    return true;
+}
+
+bool DebugRing::readLatest(cv::Mat& frame, DebugResult& result)
+{
+    if (mHeader == nullptr)
+        return false;
+
+    mHeader->viewerHeartbeat.store(now(), std::memory_order_relaxed);
+
+    const int height = static_cast<int>(mHeader->height);
+    const int width = static_cast<int>(mHeader->width);
+    frame.create(height, width, CV_8UC3);
+    const size_t frameBytes = static_cast<size_t>(width) * height * 3;
+
+    // retry a few times if the writer laps us while copying
+    for (int32_t attempt = 0; attempt < 4; ++attempt)
+    {
+        uint64_t count = mHeader->writeCount.load(std::memory_order_acquire);
+        if (count == 0)
+            return false;
+
+        DebugRingSlot* slot = getSlot(count - 1);
+        uint64_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        std::memcpy(&result, &slot->result, sizeof(DebugResult));
+        std::memcpy(frame.data, reinterpret_cast<const uint8_t*>(slot + 1), frameBytes);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+    return false;
+}
+
+DebugRingSlot* DebugRing::getSlot(uint64_t index) const
+{
+    uint8_t* base = reinterpret_cast<uint8_t*>(mHeader) + alignToCacheLine(sizeof(DebugRingHeader));
+    return reinterpret_cast<DebugRingSlot*>(base + (index % mHeader->numSlots) * mHeader->slotSize);
+}
+
+int64_t DebugRing::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+} // namespace Xycar
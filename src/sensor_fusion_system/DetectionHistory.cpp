@@ -0,0 +1,55 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file DetectionHistory.cpp
+ * @version 1.0
+ * @date 2024-02-27
+ */
+
+#include <algorithm>
+#include <iostream>
+
+#include "sensor_fusion_system/DetectionHistory.hpp"
+
+namespace Xycar {
+
+DetectionHistory::DetectionHistory(uint32_t capacity) : mFrames(std::max<uint32_t>(capacity, 1))
+{
+    if (capacity == 0)
+        std::cerr << "LATE_FUSION.HISTORY_SIZE must be at least 1, keeping 1 frame" << std::endl;
+}
+
+void DetectionHistory::push(uint64_t stamp, const std::vector<Detection>& detections)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    DetectionFrame& frame = mFrames[mNext];
+    frame.stamp = stamp;
+    frame.detections.assign(detections.begin(), detections.end());
+    mNext = (mNext + 1) % mFrames.size();
+    mSize = std::min(mSize + 1, mFrames.size());
+}
+
+bool DetectionHistory::getClosest(uint64_t stamp, DetectionFrame& frame) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    const DetectionFrame* closest = nullptr;
+    uint64_t closestGap = 0;
+    for (size_t i = 0; i < mSize; ++i)
+    {
+        const DetectionFrame& candidate = mFrames[i];
+        uint64_t gap = candidate.stamp > stamp ? candidate.stamp - stamp : stamp - candidate.stamp;
+        if (closest == nullptr || gap < closestGap)
+        {
+            closest = &candidate;
+            closestGap = gap;
+        }
+    }
+    if (closest == nullptr)
+        return false;
+
+    frame.stamp = closest->stamp;
+    frame.detections.assign(closest->detections.begin(), closest->detections.end());
+    return true;
+}
+} // namespace Xycar
@@ -0,0 +1,39 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file EgoMotion.cpp
+ * @version 1.0
+ * @date 2024-03-01
+ */
+
+#include <cmath>
+
+#include "sensor_fusion_system/EgoMotion.hpp"
+
+namespace Xycar {
+template <typename PREC>
+EgoMotion<PREC> EgoMotion<PREC>::fromCommand(PREC speed, PREC wheelAngle, PREC wheelbase, PREC dt)
+{
+    // the chord of the arc leaves at half the heading change, exact for a constant yaw rate up to the chord/arc length
+    EgoMotion motion;
+    const PREC distance = speed * dt;
+    motion.yaw = distance * std::tan(wheelAngle) / wheelbase;
+    motion.dx = distance * std::cos(motion.yaw / 2);
+    motion.dy = distance * std::sin(motion.yaw / 2);
+    return motion;
+}
+
+template <typename PREC>
+cv::Point_<PREC> EgoMotion<PREC>::apply(PREC x, PREC y) const
+{
+    const PREC cosYaw = std::cos(yaw);
+    const PREC sinYaw = std::sin(yaw);
+    x -= dx;
+    y -= dy;
+    return cv::Point_<PREC>(cosYaw * x + sinYaw * y, -sinYaw * x + cosYaw * y);
+}
+
+template struct EgoMotion<float>;
+template struct EgoMotion<double>;
+} // namespace Xycar
@@ -0,0 +1,70 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file EmergencyStop.cpp
+ * @version 1.0
+ * @date 2024-02-24
+ */
+
+#include <cmath>
+
+#include "sensor_fusion_system/EmergencyStop.hpp"
+
+namespace Xycar {
+
+template <typename PREC>
+void EmergencyStop<PREC>::setScanGeometry(PREC angleMin, PREC angleIncrement, uint32_t numBeams, PREC rangeMin)
+{
+    mRangeMin = rangeMin;
+    if (angleMin == mAngleMin && angleIncrement == mAngleIncrement && numBeams == mNumBeams)
+        return;
+    mAngleMin = angleMin;
+    mAngleIncrement = angleIncrement;
+    mNumBeams = numBeams;
+
+    mBeams.clear();
+    mForward.clear();
+    mLateral.clear();
+    for (uint32_t i = 0; i < numBeams; ++i)
+    {
+        PREC angle = angleMin + i * angleIncrement - mForwardAngle;
+        PREC forward = std::cos(angle);
+        if (forward <= 0)
+            continue;
+        mBeams.push_back(i);
+        mForward.push_back(forward);
+        mLateral.push_back(std::abs(std::sin(angle)));
+    }
+}
+
+template <typename PREC>
+bool EmergencyStop<PREC>::update(const float* ranges, size_t count, PREC speed)
+{
+    const PREC reach = mFrontOffset + getStoppingDistance(speed);
+
+    uint32_t inside = 0;
+    for (size_t b = 0; b < mBeams.size(); ++b)
+    {
+        const uint32_t i = mBeams[b];
+        if (i >= count)
+            break;
+        // NaN fails every comparison, inf the first two
+        const PREC r = ranges[i];
+        if (r > mRangeMin && r * mForward[b] <= reach && r * mLateral[b] <= mHalfWidth)
+            ++inside;
+    }
+
+    if (inside >= mMinPoints)
+    {
+        mStopped = true;
+        mClearCount = 0;
+    }
+    else if (mStopped && ++mClearCount >= mClearScans)
+        mStopped = false;
+    return mStopped;
+}
+
+template class EmergencyStop<float>;
+template class EmergencyStop<double>;
+} // namespace Xycar
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/ExplicitMPCController.hpp"
+namespace Xycar {
+
+template <typename PREC>
+ExplicitMPCController<PREC>::ExplicitMPCController(const std::string& tablePath, PREC metersPerPixel, PREC speedToMps, PREC commandPerDegree,
+                                                   int32_t steeringLimit, PREC controlPeriod)
+    : mMetersPerPixel(metersPerPixel), mSpeedToMps(speedToMps), mCommandPerRadian(commandPerDegree * static_cast<PREC>(180.0 / M_PI)),
+      mSteeringLimit(steeringLimit), mControlPeriod(controlPeriod)
+{
+    try
+    {
+        YAML::Node table = YAML::LoadFile(tablePath);
+        mSpeeds = table["SPEEDS"].as<std::vector<PREC>>();
+        mLateralMin = table["LATERAL_MIN"].as<PREC>();
+        mLateralStep = table["LATERAL_STEP"].as<PREC>();
+        mLateralCount = table["LATERAL_COUNT"].as<int32_t>();
+        mHeadingMin = table["HEADING_MIN"].as<PREC>();
+        mHeadingStep = table["HEADING_STEP"].as<PREC>();
+        mHeadingCount = table["HEADING_COUNT"].as<int32_t>();
+        mTable = table["STEERING"].as<std::vector<PREC>>();
+        mLoaded = !mSpeeds.empty() && mLateralCount >= 2 && mHeadingCount >= 2 && mLateralStep > 0 && mHeadingStep > 0 &&
+                  mTable.size() == mSpeeds.size() * mLateralCount * mHeadingCount;
+        if (!mLoaded)
+            std::cerr << "Invalid MPC table: " << tablePath << std::endl;
+    }
+    catch (const YAML::Exception& e)
+    {
+        // missing file or missing key, the generator has probably not been run
+        std::cerr << "Could not read the MPC table " << tablePath << ": " << e.what() << std::endl;
+    }
+
+    if (!mLoaded)
+    {
+        // a flat zero table, so getControlOutput stays defined
+        mSpeeds.assign(1, 0);
+        mLateralMin = mHeadingMin = 0;
+        mLateralStep = mHeadingStep = 1;
+        mLateralCount = mHeadingCount = 2;
+        mTable.assign(4, 0);
+    }
+}
+
+template <typename PREC>
+PREC ExplicitMPCController<PREC>::interpolate(int32_t speedIndex, PREC lateralPosition, PREC headingPosition) const
+{
+    int32_t i = std::min(static_cast<int32_t>(lateralPosition), mLateralCount - 2);
+    int32_t j = std::min(static_cast<int32_t>(headingPosition), mHeadingCount - 2);
+    PREC s = lateralPosition - i;
+    PREC t = headingPosition - j;
+
+    const PREC* layer = mTable.data() + static_cast<size_t>(speedIndex) * mLateralCount * mHeadingCount;
+    const PREC* row0 = layer + i * mHeadingCount + j;
+    const PREC* row1 = row0 + mHeadingCount;
+    PREC top = row0[0] + (row0[1] - row0[0]) * t;
+    PREC bottom = row1[0] + (row1[1] - row1[0]) * t;
+    return top + (bottom - top) * s;
+}
+
+template <typename PREC>
+PREC ExplicitMPCController<PREC>::getControlOutput(int32_t errorFromMid)
+{
+    // positive error: the lane is right of the car, i.e. the car is left of the lane centre (positive lateral error)
+    PREC lateral = errorFromMid * mMetersPerPixel;
+    PREC heading = 0;
+    if (mHasPrevious && mSpeed > static_cast<PREC>(0.05))
+        heading = (lateral - mPreviousLateral) / (mSpeed * mControlPeriod);
+    mPreviousLateral = lateral;
+    mHasPrevious = true;
+
+    PREC lateralPosition = std::clamp((lateral - mLateralMin) / mLateralStep, static_cast<PREC>(0), static_cast<PREC>(mLateralCount - 1));
+    PREC headingPosition = std::clamp((heading - mHeadingMin) / mHeadingStep, static_cast<PREC>(0), static_cast<PREC>(mHeadingCount - 1));
+
+    PREC wheelAngle;
+    auto upper = std::upper_bound(mSpeeds.begin(), mSpeeds.end(), mSpeed);
+    if (upper == mSpeeds.begin())
+        wheelAngle = interpolate(0, lateralPosition, headingPosition);
+    else if (upper == mSpeeds.end())
+        wheelAngle = interpolate(static_cast<int32_t>(mSpeeds.size()) - 1, lateralPosition, headingPosition);
+    else
+    {
+        int32_t k = static_cast<int32_t>(upper - mSpeeds.begin());
+        PREC w = (mSpeed - mSpeeds[k - 1]) / (mSpeeds[k] - mSpeeds[k - 1]);
+        PREC low = interpolate(k - 1, lateralPosition, headingPosition);
+        PREC high = interpolate(k, lateralPosition, headingPosition);
+        wheelAngle = low + (high - low) * w;
+    }
+
+    // the model steers left with positive angles, xycar steers right with positive commands
+    return std::clamp(-wheelAngle * mCommandPerRadian, -mSteeringLimit, mSteeringLimit);
+}
+
+template class ExplicitMPCController<float>;
+template class ExplicitMPCController<double>;
+} // namespace Xycar
@@ -8,9 +8,107 @@ LaneKeepingSystem<PREC>::LaneKeepingSystem()
     mNodeHandler.getParam("config_path", configPath);
     YAML::Node config = YAML::LoadFile(configPath);
 
-    mPID = new PIDController<PREC>(config["PID"]["P_GAIN"].as<PREC>(), config["PID"]["I_GAIN"].as<PREC>(), config["PID"]["D_GAIN"].as<PREC>());
+    std::string controllerType = config["CONTROLLER"].as<std::string>();
+    int32_t maxLaneError = config["IMAGE"]["WIDTH"].as<int32_t>() / 2;
+    if (controllerType == "PURE_PURSUIT")
+        mController = new PurePursuitController<PREC>(config["GEOMETRY"]["METERS_PER_PIXEL"].as<PREC>(), config["PURE_PURSUIT"]["LOOKAHEAD"].as<PREC>(),
+                                                       config["GEOMETRY"]["WHEELBASE"].as<PREC>(), config["GEOMETRY"]["COMMAND_PER_DEGREE"].as<PREC>(),
+                                                       maxLaneError, kXycarSteeringAangleLimit);
+    else if (controllerType == "STANLEY")
+        mController = new StanleyController<PREC>(config["GEOMETRY"]["METERS_PER_PIXEL"].as<PREC>(), config["STANLEY"]["GAIN"].as<PREC>(),
+                                                   config["STANLEY"]["SOFTENING_SPEED"].as<PREC>(), config["GEOMETRY"]["SPEED_TO_MPS"].as<PREC>(),
+                                                   config["GEOMETRY"]["COMMAND_PER_DEGREE"].as<PREC>(), kXycarSteeringAangleLimit);
+    else if (controllerType == "MPC")
+    {
+        ExplicitMPCController<PREC>* mpc = new ExplicitMPCController<PREC>(
+            config["MPC"]["TABLE"].as<std::string>(), config["GEOMETRY"]["METERS_PER_PIXEL"].as<PREC>(), config["GEOMETRY"]["SPEED_TO_MPS"].as<PREC>(),
+            config["GEOMETRY"]["COMMAND_PER_DEGREE"].as<PREC>(), kXycarSteeringAangleLimit, config["MPC"]["CONTROL_PERIOD"].as<PREC>());
+        if (mpc->isLoaded())
+            mController = mpc;
+        else
+        {
+            std::cerr << "MPC table not usable, falling back to PID" << std::endl;
+            delete mpc;
+        }
+    }
+    else if (controllerType != "PID")
+        std::cerr << "Unknown CONTROLLER " << controllerType << ", falling back to PID" << std::endl;
+
+    // PID is also the fallback of a controller that could not be set up
+    if (mController == nullptr)
+    {
+        if (config["PID"]["SCHEDULE"])
+        {
+            std::vector<PREC> speeds;
+            std::vector<typename PIDController<PREC>::Gains> gains;
+            for (const YAML::Node& entry : config["PID"]["SCHEDULE"])
+            {
+                speeds.push_back(entry["SPEED"].as<PREC>());
+                gains.push_back({entry["P_GAIN"].as<PREC>(), entry["I_GAIN"].as<PREC>(), entry["D_GAIN"].as<PREC>()});
+            }
+            if (PIDController<PREC>::isValidSchedule(speeds, gains))
+                mController = new PIDController<PREC>(speeds, gains);
+            else
+            {
+                std::cerr << "PID.SCHEDULE needs at least one entry and strictly increasing SPEED, using P_GAIN, I_GAIN and D_GAIN" << std::endl;
+                mController = new PIDController<PREC>(config["PID"]["P_GAIN"].as<PREC>(), config["PID"]["I_GAIN"].as<PREC>(),
+                                                      config["PID"]["D_GAIN"].as<PREC>());
+            }
+        }
+        else
+            mController = new PIDController<PREC>(config["PID"]["P_GAIN"].as<PREC>(), config["PID"]["I_GAIN"].as<PREC>(), config["PID"]["D_GAIN"].as<PREC>());
+    }
     mMovingAverage = new MovingAverageFilter<PREC>(config["MOVING_AVERAGE_FILTER"]["SAMPLE_SIZE"].as<uint32_t>());
-    mCameraDetector = new CameraDetector<PREC>(config);
+    if (config["MAT_ALLOCATOR"]["ENABLE"].as<bool>())
+    {
+        // installed before the first Mat of the node and intentionally leaked, Mats may outlive the node
+        mMatAllocator = new PoolMatAllocator(config["MAT_ALLOCATOR"]["HUGE_PAGES"].as<bool>(),
+                                             config["MAT_ALLOCATOR"]["MAX_CACHED_MB"].as<size_t>() << 20);
+        cv::Mat::setDefaultAllocator(mMatAllocator);
+    }
+    mImageTransportLatency = mLatencyMonitor.addChannel("image transport");
+    mScanTransportLatency = mLatencyMonitor.addChannel("scan transport");
+    mDetectionLatency = mLatencyMonitor.addChannel("capture to detections");
+    mStopLatency = mLatencyMonitor.addChannel("scan to emergency stop");
+    mTaskPool = new TaskPool(config["TASK_POOL"]["WORKERS"].as<uint32_t>());
+    mCameraDetector = new CameraDetector<PREC>(config, mTaskPool);
+    mPipeline = new Pipeline(mTaskPool);
+    registerStages();
+    if (!mPipeline->configure(config["PIPELINE"]))
+        throw std::runtime_error("Invalid PIPELINE, nothing would be processed");
+    mScanFilter = new ScanFilterChain<PREC>(config["SCAN_FILTER"]);
+    mSegmenter = new ScanSegmenter<PREC>(config["SCAN_SEGMENTER"]["LAMBDA"].as<PREC>(), config["SCAN_SEGMENTER"]["SIGMA"].as<PREC>(),
+                                         config["SCAN_SEGMENTER"]["MIN_POINTS"].as<uint32_t>(), config["SCAN_SEGMENTER"]["MAX_RANGE"].as<PREC>());
+    if (config["EMERGENCY_STOP"]["ENABLE"].as<bool>())
+    {
+        const YAML::Node& stop = config["EMERGENCY_STOP"];
+        mEmergencyStop = new EmergencyStop<PREC>(stop["FORWARD_ANGLE"].as<PREC>(), stop["HALF_WIDTH"].as<PREC>(), stop["FRONT_OFFSET"].as<PREC>(),
+                                                 stop["MARGIN"].as<PREC>(), stop["REACTION_TIME"].as<PREC>(), stop["DECELERATION"].as<PREC>(),
+                                                 stop["MIN_POINTS"].as<uint32_t>(), stop["CLEAR_SCANS"].as<uint32_t>());
+    }
+    mDetectionHistory = new DetectionHistory(config["LATE_FUSION"]["HISTORY_SIZE"].as<uint32_t>());
+    mTracker = new ObjectTracker<PREC>(config["TRACKER"]["GATE_DISTANCE"].as<PREC>(), config["TRACKER"]["ALPHA"].as<PREC>(),
+                                       config["TRACKER"]["BETA"].as<PREC>(), config["TRACKER"]["MAX_AGE"].as<PREC>());
+    if (config["RECORDER"]["ENABLE"].as<bool>())
+    {
+        FrameCodec codec = config["RECORDER"]["FRAME_CODEC"].as<std::string>() == "PNG" ? FrameCodec::PNG : FrameCodec::JPEG;
+        mRecorder = new Recorder(config["RECORDER"]["PATH"].as<std::string>(), codec, config["RECORDER"]["JPEG_QUALITY"].as<int32_t>(),
+                                 config["RECORDER"]["QUEUE_SIZE"].as<uint32_t>());
+    }
+    if (config["RESULTS_LOG"]["ENABLE"].as<bool>())
+    {
+        std::vector<std::string> stageNames;
+        for (const StageStatistics& stage : mPipeline->getStatistics())
+            stageNames.push_back(stage.name);
+        const YAML::Node& log = config["RESULTS_LOG"];
+        mResultsLog = new ResultsLog(log["PATH"].as<std::string>(), stageNames, log["BLOCK_ROWS"].as<uint32_t>(),
+                                     log["COMPRESSION_LEVEL"].as<int32_t>(), log["QUEUE_SIZE"].as<uint32_t>());
+    }
+    if (config["DEBUG_RING"]["ENABLE"].as<bool>())
+    {
+        mDebugRing = new DebugRing(config["DEBUG_RING"]["NAME"].as<std::string>(), config["DEBUG_RING"]["SLOTS"].as<uint32_t>(),
+                                   config["IMAGE"]["WIDTH"].as<uint32_t>(), config["IMAGE"]["HEIGHT"].as<uint32_t>());
+    }
     /*
         create your lane detector.
     */
@@ -19,6 +117,7 @@ LaneKeepingSystem<PREC>::LaneKeepingSystem()
     mPublisher = mNodeHandler.advertise<xycar_msgs::xycar_motor>(mPublishingTopicName, mQueueSize);
     mSubscriber = mNodeHandler.subscribe(mSubscribedTopicName, mQueueSize, &LaneKeepingSystem::imageCallback, this);
     mSubLidar = mNodeHandler.subscribe(mSubscribedLidarName, mQueueSize, &LaneKeepingSystem::scanCallback, this);
+    mSubMotor = mNodeHandler.subscribe(mPublishingTopicName, mQueueSize, &LaneKeepingSystem::motorCallback, this);
 }
 
 template <typename PREC>
@@ -34,22 +133,38 @@ void LaneKeepingSystem<PREC>::setParams(const YAML::Node& config)
     mXycarSpeedControlThreshold = config["XYCAR"]["SPEED_CONTROL_THRESHOLD"].as<PREC>();
     mAccelerationStep = config["XYCAR"]["ACCELERATION_STEP"].as<PREC>();
     mDecelerationStep = config["XYCAR"]["DECELERATION_STEP"].as<PREC>();
+    mActuatorDelay = config["TRACKER"]["ACTUATOR_DELAY"].as<PREC>();
+    mSpeedToMps = config["GEOMETRY"]["SPEED_TO_MPS"].as<PREC>();
+    mRadianPerCommand = static_cast<PREC>(M_PI / 180.0) / config["GEOMETRY"]["COMMAND_PER_DEGREE"].as<PREC>();
+    mWheelbase = config["GEOMETRY"]["WHEELBASE"].as<PREC>();
+    mRateReportPeriod = config["PIPELINE_REPORT_PERIOD"].as<double>();
+    mCameraTimeOffset = static_cast<int64_t>(config["SYNC"]["CAMERA_TIME_OFFSET"].as<double>() * 1e9);
+    mMaxPairingGap = static_cast<uint64_t>(config["LATE_FUSION"]["MAX_PAIRING_GAP"].as<double>() * 1e9);
+    mTrackScanObjects = config["TRACKER"]["INPUT"].as<std::string>() == "SCAN";
     mDebugging = config["DEBUG"].as<bool>();
 }
 
 template <typename PREC>
 LaneKeepingSystem<PREC>::~LaneKeepingSystem()
 {
-    delete mPID;
+    delete mController;
     delete mMovingAverage;
+    delete mScanFilter;
+    delete mEmergencyStop;
+    delete mSegmenter;
+    delete mDetectionHistory;
+    delete mTracker;
+    delete mRecorder;
+    delete mResultsLog;
+    delete mDebugRing;
+    delete mPipeline;
+    delete mTaskPool;
     // delete your CameraDetector if you add your CameraDetector.
 }
 
 template <typename PREC>
 void LaneKeepingSystem<PREC>::run()
 {
-    ros::Rate rate(kFrameRate);
-
     // intrinsic setting & model setting
     mCameraDetector->undistortAndDNNConfig();
 
@@ -61,40 +176,356 @@ void LaneKeepingSystem<PREC>::run()
     mCameraDetector->getLidarExtrinsicMatrix(image2D, lidar3D);
     mCameraDetector->getVCSExtrinsicMatrix(image2D, vcs3D);
 
+    // the scan plane to VCS map is affine, three points define it
+    auto planeToVCS = [this](float x, float y) {
+        cv::Point3f vcs = mCameraDetector->getVCSCoordPointsFromLidar(cv::Point3f(y, CameraDetector<PREC>::kLidarPlaneY, -x));
+        return cv::Point_<PREC>(vcs.x, vcs.y);
+    };
+    cv::Point_<PREC> origin = planeToVCS(0, 0);
+    mSegmenter->setLidarToVCS(origin, planeToVCS(1, 0) - origin, planeToVCS(0, 1) - origin);
+
     while (ros::ok())
     {
-        ros::spinOnce();
+        // wake up as soon as a message arrives, the stages run at the rate of their own trigger
+        ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(kIdleWait));
+        uint32_t events = mPendingEvents;
+        mPendingEvents = 0;
+        mPipeline->run(events);
+        // HighGUI is not thread safe, stages may run on the pool, so the window is only updated here
+        if (mFrameDrawn) {
+            mFrameDrawn = false;
+            mCameraDetector->show();
+        }
+        // after the whole iteration, so the stage run times of the frame are complete
+        if (mResultsLog != nullptr)
+            logResults();
+
+        if (mRateReportPeriod > 0 && (ros::WallTime::now() - mLastRateReport).toSec() >= mRateReportPeriod)
+        {
+            mLastRateReport = ros::WallTime::now();
+            for (const StageStatistics& stage : mPipeline->getStatistics())
+                std::cout << "stage " << stage.name << ": " << stage.rate << " Hz, " << stage.duration << " ms" << std::endl;
+            for (const LatencyStatistics& latency : mLatencyMonitor.getStatistics())
+                std::cout << "latency " << latency.name << ": median " << latency.median << " ms, p90 " << latency.p90 << " ms, p99 "
+                          << latency.p99 << " ms, max " << latency.max << " ms (" << latency.count << " samples)" << std::endl;
+            if (mMatAllocator != nullptr)
+            {
+                PoolMatAllocatorStatistics pool = mMatAllocator->getStatistics();
+                std::cout << "mat allocator: " << pool.poolHits << "/" << pool.allocations << " from pool, " << pool.largeAllocations
+                          << " unpooled, " << (pool.cachedBytes >> 20) << " MiB cached" << std::endl;
+            }
+            if (mRecorder != nullptr)
+                std::cout << "recorder: " << mRecorder->getDroppedCount() << " records dropped" << std::endl;
+            if (mResultsLog != nullptr)
+                std::cout << "results log: " << mResultsLog->getDroppedCount() << " entries dropped" << std::endl;
+        }
+    }
+}
 
-        // Lidar
-        std::vector<cv::Point3f> objectPoints;
+template <typename PREC>
+void LaneKeepingSystem<PREC>::registerStages()
+{
+    // a new stage is a function registered here plus an entry in PIPELINE, the loop in run() stays the same
+    mPipeline->registerStage("INGEST_IMAGE", [this] {
+        if (mFrame.empty())
+            return false;
+        mFrameData.frame = mFrame;
+        mFrameData.stamp = mFrameStamp;
+        return true;
+    });
+
+    mPipeline->registerStage("INGEST_SCAN", [this] {
+        // Lidar, the segmenter needs the scan even if no point reaches the image
+        if (mScanRanges.empty())
+            return false;
+
+        if (mDebugging)
+            std::cout << "mLidarCoord size: " << mLidarCoord.size() << std::endl;
+
+        FrameData& data = mFrameData;
+        data.scanStamp = mScanStamp;
+        data.objectPoints.clear();
+        for (const cv::Point2f& point : mLidarCoord) {
+            // convert lidar coord to camera coord
+            data.objectPoints.push_back(cv::Point3f(point.y, CameraDetector<PREC>::kLidarPlaneY, -point.x));
+        }
+        data.beamIndices = mLidarBeamIndices;
+        data.ranges = mLidarRanges;
+        data.scanRanges = mScanRanges;
+        data.scanAngleMin = mScanAngleMin;
+        data.scanAngleIncrement = mScanAngleIncrement;
+        return true;
+    });
+
+    mPipeline->registerStage("UNDISTORT", [this] {
+        if (mFrameData.frame.empty())
+            return false;
+        mCameraDetector->undistort(mFrameData.frame);
+        return true;
+    });
+
+    mPipeline->registerStage("DETECT", [this] {
+        mCameraDetector->detect();
+        // kept for LATE_FUSE, which pairs each scan with the frame closest to it once it arrives
+        mDetectionHistory->push(mFrameData.stamp, mCameraDetector->getDetections());
+        return true;
+    });
+
+    mPipeline->registerStage("CLASSIFY", [this] {
+        // crops come from the raw frame, independent of UNDISTORT
+        mCameraDetector->classify(mFrameData.frame);
+        return true;
+    });
+
+    mPipeline->registerStage("PROJECT", [this] {
+        // get (u,v) 2d images from the projection table (or projectPoints)
+        mFrameData.lidarImagePoints = mCameraDetector->getProjectPoints(mFrameData.objectPoints, mFrameData.beamIndices, mFrameData.ranges);
+        return true;
+    });
+
+    mPipeline->registerStage("LIDAR_VCS", [this] {
+        // once per scan, every frame until the next scan reuses these
+        FrameData& data = mFrameData;
+        data.lidarVcs.resize(data.objectPoints.size());
+        mTaskPool->parallelFor(data.objectPoints.size(), [&](size_t i) {
+            data.lidarVcs[i] = mCameraDetector->getVCSCoordPointsFromLidar(data.objectPoints[i]);
+        });
+        return true;
+    });
+
+    mPipeline->registerStage("SEGMENT", [this] {
+        // obstacles from the lidar alone, at scan rate and in VCS at scanStamp
+        const FrameData& data = mFrameData;
+        mSegmenter->segment(data.scanRanges, data.scanAngleMin, data.scanAngleIncrement);
+        if (mDebugging) {
+            for (const ScanSegment<PREC>& segment : mSegmenter->getSegments())
+                std::cout << "segment " << segment.start << " - " << segment.end << ", " << segment.numPoints << " points" << std::endl;
+        }
+        return true;
+    });
+
+    mPipeline->registerStage("ASSOCIATE", [this] {
+        mCameraDetector->associate(mFrameData.lidarImagePoints);
+        return true;
+    });
+
+    mPipeline->registerStage("LABEL_SEGMENTS", [this] {
+        // camera detections name the segments their lidar points belong to
+        const FrameData& data = mFrameData;
+        std::vector<int> beams;
+        for (const Detection& detection : mCameraDetector->getDetections()) {
+            beams.clear();
+            for (int idx : detection.pointIndices)
+                beams.push_back(data.beamIndices[idx]);
+            mSegmenter->label(beams, detection.classId, detection.confidence);
+        }
+        return true;
+    });
+
+    mPipeline->registerStage("FUSE", [this] {
+        FrameData& data = mFrameData;
+        const std::vector<Detection>& detections = mCameraDetector->getDetections();
+
+        data.result = {};
+        data.result.frameId = ++mFrameCount;
+        data.result.stamp = data.stamp;
+        data.result.numBoxes = std::min<uint32_t>(detections.size(), kDebugRingMaxBoxes);
+
+        // the lidar points are as old as the scan, move them by the ego-motion between the scan and the frame
+        // (constant speed and yaw rate from the last command on the motor topic, static world)
+        const PREC dt = static_cast<PREC>(static_cast<int64_t>(data.stamp - data.scanStamp)) * static_cast<PREC>(1e-9);
+        // positive steering commands turn right, the VCS yaw is counterclockwise
+        const EgoMotion<PREC> motion =
+            EgoMotion<PREC>::fromCommand(mCommandedSpeed * mSpeedToMps, -mCommandedAngle * mRadianPerCommand, mWheelbase, dt);
+
+        FusedObjects& objects = data.imageObjects;
+        objects.clear();
+        objects.stamp = data.stamp;
+        data.distances.clear();
+        data.rangeSources.clear();
+        for (int d = 0; d < detections.size(); ++d) {
+            float closest = -1.f;
+            cv::Point_<PREC> position;
+            RangeSource source = locate(detections[d], data.lidarVcs, motion, position, closest);
+            data.distances.push_back(closest);
+            data.rangeSources.push_back(source);
+            if (source != RangeSource::NONE) {
+                objects.positions.push_back(position);
+                objects.classIds.push_back(detections[d].classId);
+                objects.sources.push_back(source);
+            }
+
+            if (d < data.result.numBoxes) {
+                const cv::Rect& box = detections[d].box;
+                data.result.boxes[d] = {box.x, box.y, box.width, box.height, detections[d].classId, detections[d].confidence,
+                                        static_cast<uint32_t>(detections[d].pointIndices.size()), closest, source};
+            }
+        }
+        const uint64_t fusedStamp = ros::Time::now().toNSec();
+        data.detectionLatency = static_cast<float>(static_cast<int64_t>(fusedStamp - data.stamp) * 1e-6);
+        mLatencyMonitor.record(mDetectionLatency, data.stamp, fusedStamp);
+        return true;
+    });
+
+    mPipeline->registerStage("LATE_FUSE", [this] {
+        // at scan rate: the scan is fused with the detections of the frame closest to it, which usually
+        // arrived before it, so neither the scan nor the frame waits for the other sensor
+        FrameData& data = mFrameData;
+        FusedObjects& objects = data.scanObjects;
+        objects.clear();
+        objects.stamp = data.scanStamp;
+        if (!mDetectionHistory->getClosest(data.scanStamp, mLateFrame))
+            return true;
+
+        const uint64_t gap = mLateFrame.stamp > data.scanStamp ? mLateFrame.stamp - data.scanStamp : data.scanStamp - mLateFrame.stamp;
+        if (gap > mMaxPairingGap) {
+            if (mDebugging)
+                std::cout << "late fusion: closest frame " << gap * 1e-6 << " ms from the scan, not fused" << std::endl;
+            return true;
+        }
 
-        if (mLidarCoord.size() == 0)
-            continue;
+        // same scan, so the points of lidarImagePoints and lidarVcs line up, and no ego-motion to undo
+        mCameraDetector->associate(data.lidarImagePoints, mLateFrame.detections);
+        const EgoMotion<PREC> noMotion;
+        for (const Detection& detection : mLateFrame.detections) {
+            float closest = -1.f;
+            cv::Point_<PREC> position;
+            RangeSource source = locate(detection, data.lidarVcs, noMotion, position, closest);
+            if (source != RangeSource::NONE) {
+                objects.positions.push_back(position);
+                objects.classIds.push_back(detection.classId);
+                objects.sources.push_back(source);
+            }
+        }
+        return true;
+    });
 
-        std::cout << "mLidarCoord size: " << mLidarCoord.size() << std::endl;
+    mPipeline->registerStage("TRACK", [this] {
+        // the positions above are as old as their stamp, propagate them to when a command computed now acts on the car
+        const FusedObjects& objects = mTrackScanObjects ? mFrameData.scanObjects : mFrameData.imageObjects;
+        if (objects.stamp == 0)
+            return false;
 
-        for (int i=0; i < mLidarCoord.size(); ++i){
-            // convert lidar coord to camera coord
-            objectPoints.push_back(cv::Point3f(mLidarCoord[i].y, -0.058, -mLidarCoord[i].x));
+        if (objects.stamp > mLastTrackedStamp) {
+            mTracker->update(objects.positions, objects.classIds, objects.stamp);
+            mLastTrackedStamp = objects.stamp;
+
+            PREC latency = std::max(static_cast<PREC>(0), static_cast<PREC>((ros::Time::now() - ros::Time().fromNSec(objects.stamp)).toSec()));
+            mPipelineLatency = mPipelineLatency == 0 ? latency : mPipelineLatency + kLatencySmoothing * (latency - mPipelineLatency);
         }
 
-        // get (u,v) 2d images from projectPoints
-        std::vector<cv::Point2f> lidarImagePoints = mCameraDetector->getProjectPoints(objectPoints);
+        uint64_t actuationStamp = objects.stamp + static_cast<uint64_t>((mPipelineLatency + mActuatorDelay) * 1e9);
+        mPredictedTracks = mTracker->predict(actuationStamp);
+
+        if (mDebugging) {
+            for (const Track<PREC>& track : mPredictedTracks)
+                std::cout << "track " << track.id << " at actuation time: " << track.position << std::endl;
+        }
+        return true;
+    });
 
-        // for (int i=0; i<lidarImagePoints.size(); ++i) {
-        //     std::cout << "lidar image point x, y : " << lidarImagePoints[i].x << lidarImagePoints[i].y << std::endl;
-        // }
+    mPipeline->registerStage("VISUALIZE", [this] {
         // visualize
-        std::vector<int> bboxIdx = mCameraDetector->boundingBox(mFrame, lidarImagePoints);
-
-        std::vector<cv::Point3f> vcsCoords;
-        // convert lidar coord points to VCS coord
-        for (int idx = 0; idx < bboxIdx.size(); ++idx) {
-            cv::Point3f vcs = mCameraDetector->getVCSCoordPointsFromLidar(objectPoints[bboxIdx[idx]]);
-            vcsCoords.push_back(vcs);
-            std::cout << "vcs coordinate: " << vcs << std::endl;
+        mCameraDetector->draw(mFrameData.lidarImagePoints);
+        mFrameDrawn = true;
+        if (mDebugRing != nullptr)
+            mDebugRing->write(mCameraDetector->getDebugFrame(), mFrameData.result);
+        return true;
+    });
+}
+
+template <typename PREC>
+void LaneKeepingSystem<PREC>::logResults()
+{
+    const FrameData& data = mFrameData;
+    // LATE_FUSE runs per scan, also between frames, so its objects are logged on their own
+    if (data.scanObjects.stamp != mLoggedScanStamp) {
+        mLoggedScanStamp = data.scanObjects.stamp;
+        logObjects(data.scanObjects, FusionPass::SCAN);
+    }
+    if (mFrameCount == mLoggedFrameCount)
+        return;
+
+    mLoggedFrameCount = mFrameCount;
+    const std::vector<float>& durations = mPipeline->getLastDurations();
+    // FUSE ran in this iteration, so the detections are still those of the frame it fused
+    const std::vector<Detection>& detections = mCameraDetector->getDetections();
+
+    FrameRow frame;
+    frame.frameId = data.result.frameId;
+    frame.stamp = data.stamp;
+    frame.scanStamp = data.scanStamp;
+    frame.detectionLatency = data.detectionLatency;
+    frame.iterationDuration = 0;
+    for (float duration : durations)
+        frame.iterationDuration += std::max(duration, 0.f);
+    frame.numBoxes = static_cast<uint32_t>(data.distances.size());
+    frame.numTracks = static_cast<uint32_t>(mTracker->getTracks().size());
+    frame.steeringAngle = static_cast<float>(mCommandedAngle);
+    frame.speed = static_cast<float>(mCommandedSpeed);
+    frame.emergencyStop = mEmergencyStop != nullptr && mEmergencyStop->isStopped();
+
+    // every detection, the debug ring keeps only the first kDebugRingMaxBoxes
+    mLogBoxes.clear();
+    for (size_t d = 0; d < data.distances.size() && d < detections.size(); ++d) {
+        const cv::Rect& box = detections[d].box;
+        mLogBoxes.push_back({frame.frameId, detections[d].classId, detections[d].confidence, box.x, box.y, box.width, box.height,
+                             static_cast<uint32_t>(detections[d].pointIndices.size()), data.distances[d],
+                             static_cast<uint8_t>(data.rangeSources[d])});
+    }
+    mResultsLog->add(frame, mLogBoxes, durations);
+    logObjects(data.imageObjects, FusionPass::FRAME);
+}
+
+template <typename PREC>
+void LaneKeepingSystem<PREC>::logObjects(const FusedObjects& objects, FusionPass pass)
+{
+    mLogObjects.clear();
+    for (size_t i = 0; i < objects.positions.size(); ++i) {
+        mLogObjects.push_back({mFrameCount, objects.stamp, static_cast<uint8_t>(pass), objects.classIds[i],
+                               static_cast<float>(objects.positions[i].x), static_cast<float>(objects.positions[i].y),
+                               static_cast<uint8_t>(objects.sources[i])});
+    }
+    mResultsLog->add(mLogObjects);
+}
+
+template <typename PREC>
+RangeSource LaneKeepingSystem<PREC>::locate(const Detection& detection, const std::vector<cv::Point3f>& lidarVcs, const EgoMotion<PREC>& motion,
+                                            cv::Point_<PREC>& position, float& distance) const
+{
+    distance = -1.f;
+    if (!detection.pointIndices.empty()) {
+        // undo the ego-motion (constant speed and yaw rate, static world) between the scan and the target time
+        cv::Point_<PREC> centroid(0, 0);
+        for (int idx : detection.pointIndices) {
+            cv::Point_<PREC> vcs = motion.apply(lidarVcs[idx].x, lidarVcs[idx].y);
+
+            float range = std::hypot(vcs.x, vcs.y);
+            if (distance < 0 || range < distance)
+                distance = range;
+            centroid += vcs;
         }
+        position = centroid * (static_cast<PREC>(1) / detection.pointIndices.size());
+        return RangeSource::LIDAR;
+    }
+
+    // outside the scan plane or out of lidar range, fall back to the ground contact of the box
+    // (same frame as the image, no ego-motion to undo)
+    cv::Point3f ground;
+    if (mCameraDetector->getGroundPoint(detection.box, ground)) {
+        distance = std::hypot(ground.x, ground.y);
+        position = cv::Point_<PREC>(ground.x, ground.y);
+        return RangeSource::GROUND_PLANE;
     }
+    return RangeSource::NONE;
+}
+
+template <typename PREC>
+void LaneKeepingSystem<PREC>::motorCallback(const xycar_msgs::xycar_motor& message)
+{
+    // whoever drives the car (this node, a lane keeping node, teleop), the ego-motion follows what was sent
+    mCommandedAngle = message.angle;
+    mCommandedSpeed = message.speed;
 }
 
 template <typename PREC>
@@ -102,6 +533,15 @@ void LaneKeepingSystem<PREC>::imageCallback(const sensor_msgs::Image& message)
 {
     cv::Mat src = cv::Mat(message.height, message.width, CV_8UC3, const_cast<uint8_t*>(&message.data[0]), message.step);
     cv::cvtColor(src, mFrame, cv::COLOR_RGB2BGR);
+    // camera stamps moved onto the lidar clock, everything downstream pairs frames and scans by these
+    const uint64_t headerStamp = message.header.stamp.toNSec();
+    mFrameStamp = headerStamp + mCameraTimeOffset;
+    mLatencyMonitor.record(mImageTransportLatency, headerStamp, ros::Time::now().toNSec());
+    mPendingEvents |= Pipeline::kImageEvent;
+
+    // raw stamps, so sensor_fusion_system_time_offset can estimate the offset from recordings
+    if (mRecorder != nullptr)
+        mRecorder->addFrame(headerStamp, mFrame);
 }
 
 template <typename PREC>
@@ -112,11 +552,51 @@ void LaneKeepingSystem<PREC>::scanCallback(const sensor_msgs::LaserScan::ConstPt
     int rStart = 378;
     int rEnd = 504 + 1;
 
+    mLatencyMonitor.record(mScanTransportLatency, scan->header.stamp.toNSec(), ros::Time::now().toNSec());
+
+    // before anything else, the stop must not wait for filtering, recording or the pipeline
+    checkEmergencyStop(*scan);
+
     mLidarCoord.clear();
+    mLidarBeamIndices.clear();
+    mLidarRanges.clear();
+
+    mCameraDetector->setScanGeometry(scan->angle_min, scan->angle_increment, static_cast<uint32_t>(scan->ranges.size()));
+    mScanStamp = scan->header.stamp.toNSec();
+    mPendingEvents |= Pipeline::kScanEvent;
+
+    // filtered returns become NaN and are skipped below
+    if (mRecorder != nullptr)
+        mRecorder->addScan(scan->header.stamp.toNSec(), scan->angle_min, scan->angle_increment, scan->ranges);
+
+    mScanAngleMin = scan->angle_min;
+    mScanAngleIncrement = scan->angle_increment;
+    mScanRanges.assign(scan->ranges.begin(), scan->ranges.end());
+    mScanFilter->apply(mScanRanges, scan->angle_increment);
+
+    // only convert the beams that can reach the image, computed once from the calibration
+    const std::vector<int>& visibleBeams = mCameraDetector->getVisibleBeams();
+    if (!visibleBeams.empty())
+    {
+        for (int i : visibleBeams)
+        {
+            float r = mScanRanges[i];
+            if (!std::isfinite(r))
+                continue;
+            float theta = scan->angle_min + i * scan->angle_increment;
+
+            mLidarCoord.push_back(cv::Point2f(r * cos(theta), r * sin(theta)));
+            mLidarBeamIndices.push_back(i);
+            mLidarRanges.push_back(r);
+        }
+        return;
+    }
 
     for (int i = lStart; i < lEnd; ++i)
     {
-        float r = scan->ranges[i]; // 거리
+        float r = mScanRanges[i]; // 거리
+        if (!std::isfinite(r))
+            continue;
         float theta = scan->angle_min + i * scan->angle_increment; // 각도
 
         float x = r * cos(theta);
@@ -126,11 +606,15 @@ void LaneKeepingSystem<PREC>::scanCallback(const sensor_msgs::LaserScan::ConstPt
         point.x = x;
         point.y = y;
         mLidarCoord.push_back(point);
+        mLidarBeamIndices.push_back(i);
+        mLidarRanges.push_back(r);
     }
 
     for (int i = rStart; i < rEnd; ++i)
     {
-        float r = scan->ranges[i]; // 거리
+        float r = mScanRanges[i]; // 거리
+        if (!std::isfinite(r))
+            continue;
         float theta = scan->angle_min + i * scan->angle_increment; // 각도
 
         float x = r * cos(theta);
@@ -140,6 +624,8 @@ void LaneKeepingSystem<PREC>::scanCallback(const sensor_msgs::LaserScan::ConstPt
         point.x = x;
         point.y = y;
         mLidarCoord.push_back(point);
+        mLidarBeamIndices.push_back(i);
+        mLidarRanges.push_back(r);
     }
 
     // for (int i = 0; i < mLidarCoord.size(); ++i)
@@ -166,13 +652,51 @@ void LaneKeepingSystem<PREC>::speedControl(PREC steeringAngle)
 }
 
 template <typename PREC>
-void LaneKeepingSystem<PREC>::drive(PREC steeringAngle)
+void LaneKeepingSystem<PREC>::checkEmergencyStop(const sensor_msgs::LaserScan& scan)
+{
+    if (mEmergencyStop == nullptr)
+        return;
+
+    bool wasStopped = mEmergencyStop->isStopped();
+    mEmergencyStop->setScanGeometry(scan.angle_min, scan.angle_increment, static_cast<uint32_t>(scan.ranges.size()), scan.range_min);
+    // the car moves at what was last sent on the motor topic, whichever node sent it. While stopped that is 0,
+    // so the check is against the speed the car would resume with
+    const PREC speed = std::max(mCommandedSpeed, mXycarSpeed) * mSpeedToMps;
+    if (!mEmergencyStop->update(scan.ranges.data(), scan.ranges.size(), speed))
+    {
+        if (wasStopped)
+            std::cout << "emergency stop released" << std::endl;
+        return;
+    }
+
+    if (!wasStopped)
+    {
+        std::cout << "emergency stop: obstacle inside " << mEmergencyStop->getStoppingDistance(speed) << " m" << std::endl;
+        mXycarSpeed = mXycarMinSpeed;
+    }
+
+    xycar_msgs::xycar_motor motorMessage;
+    motorMessage.header.stamp = scan.header.stamp;
+    // keep the wheels where whoever steers the car last put them
+    motorMessage.angle = std::round(mCommandedAngle);
+    motorMessage.speed = 0;
+    mPublisher.publish(motorMessage);
+    mLatencyMonitor.record(mStopLatency, scan.header.stamp.toNSec(), ros::Time::now().toNSec());
+}
+
+template <typename PREC>
+void LaneKeepingSystem<PREC>::drive(PREC steeringAngle, uint64_t captureStamp)
 {
+    // the capture stamp travels with the command, so latency can also be measured downstream of the node
     xycar_msgs::xycar_motor motorMessage;
+    motorMessage.header.stamp = ros::Time().fromNSec(captureStamp);
     motorMessage.angle = std::round(steeringAngle);
-    motorMessage.speed = std::round(mXycarSpeed);
+    // the stop holds until the lidar callback releases it
+    motorMessage.speed = (mEmergencyStop != nullptr && mEmergencyStop->isStopped()) ? 0 : std::round(mXycarSpeed);
 
     mPublisher.publish(motorMessage);
+    mController->setSpeed(mXycarSpeed);
+    mSteeringAngle = steeringAngle;
 }
 
 template class LaneKeepingSystem<float>;
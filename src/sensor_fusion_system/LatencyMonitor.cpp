@@ -0,0 +1,62 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file LatencyMonitor.cpp
+ * @version 1.0
+ * @date 2024-02-26
+ */
+
+#include <algorithm>
+
+#include "sensor_fusion_system/LatencyMonitor.hpp"
+
+namespace Xycar {
+
+uint32_t LatencyMonitor::addChannel(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mChannels.emplace_back();
+    mChannels.back().name = name;
+    mChannels.back().samples.reserve(kWindow);
+    return static_cast<uint32_t>(mChannels.size() - 1);
+}
+
+void LatencyMonitor::record(uint32_t channel, uint64_t captureStamp, uint64_t now)
+{
+    if (captureStamp == 0)
+        return;
+
+    int64_t latency = static_cast<int64_t>(now - captureStamp);
+    std::lock_guard<std::mutex> lock(mMutex);
+    Channel& target = mChannels[channel];
+    if (target.samples.size() < kWindow)
+        target.samples.push_back(latency);
+    else
+        target.samples[target.count % kWindow] = latency;
+    ++target.count;
+}
+
+std::vector<LatencyStatistics> LatencyMonitor::getStatistics() const
+{
+    std::vector<LatencyStatistics> statistics;
+    std::vector<int64_t> sorted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const Channel& channel : mChannels)
+    {
+        LatencyStatistics entry = {channel.name, channel.count, 0.0, 0.0, 0.0, 0.0};
+        if (!channel.samples.empty())
+        {
+            sorted = channel.samples;
+            std::sort(sorted.begin(), sorted.end());
+            auto percentile = [&](double p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1))] * 1e-6; };
+            entry.median = percentile(0.5);
+            entry.p90 = percentile(0.9);
+            entry.p99 = percentile(0.99);
+            entry.max = sorted.back() * 1e-6;
+        }
+        statistics.push_back(entry);
+    }
+    return statistics;
+}
+} // namespace Xycar
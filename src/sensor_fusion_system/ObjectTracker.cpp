@@ -0,0 +1,90 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ObjectTracker.cpp
+ * @version 1.0
+ * @date 2024-02-16
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "sensor_fusion_system/ObjectTracker.hpp"
+
+namespace Xycar {
+
+template <typename PREC>
+void ObjectTracker<PREC>::update(const std::vector<cv::Point_<PREC>>& measurements, const std::vector<int32_t>& classIds, uint64_t stamp)
+{
+    std::vector<Track<PREC>> predicted = predict(stamp);
+
+    // greedy nearest neighbour: closest (track, measurement) pairs inside the gate first
+    std::vector<std::tuple<PREC, size_t, size_t>> pairs;
+    for (size_t t = 0; t < predicted.size(); ++t)
+    {
+        for (size_t m = 0; m < measurements.size(); ++m)
+        {
+            cv::Point_<PREC> diff = measurements[m] - predicted[t].position;
+            PREC distance = std::sqrt(diff.dot(diff));
+            if (distance < mGateDistance)
+                pairs.emplace_back(distance, t, m);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    std::vector<bool> trackUsed(predicted.size(), false);
+    std::vector<bool> measurementUsed(measurements.size(), false);
+    for (const auto& [distance, t, m] : pairs)
+    {
+        if (trackUsed[t] || measurementUsed[m])
+            continue;
+        trackUsed[t] = measurementUsed[m] = true;
+
+        Track<PREC>& track = predicted[t];
+        PREC dt = static_cast<PREC>(stamp - mTracks[t].stamp) * static_cast<PREC>(1e-9);
+        cv::Point_<PREC> residual = measurements[m] - track.position;
+        track.position += residual * mAlpha;
+        if (dt > 0)
+            track.velocity += residual * (mBeta / dt);
+        track.classId = classIds[m];
+        ++track.hits;
+    }
+
+    // unmatched tracks keep their last corrected state until they get too old
+    std::vector<Track<PREC>> tracks;
+    for (size_t t = 0; t < predicted.size(); ++t)
+    {
+        if (trackUsed[t])
+            tracks.push_back(predicted[t]);
+        else if (stamp - mTracks[t].stamp < mMaxAgeNs)
+            tracks.push_back(mTracks[t]);
+    }
+
+    for (size_t m = 0; m < measurements.size(); ++m)
+    {
+        if (!measurementUsed[m])
+            tracks.push_back({mNextId++, classIds[m], measurements[m], cv::Point_<PREC>(0, 0), stamp, 1});
+    }
+
+    mTracks = std::move(tracks);
+}
+
+template <typename PREC>
+std::vector<Track<PREC>> ObjectTracker<PREC>::predict(uint64_t stamp) const
+{
+    std::vector<Track<PREC>> predicted = mTracks;
+    for (Track<PREC>& track : predicted)
+    {
+        // signed, a stamp before the track time propagates backwards
+        PREC dt = static_cast<PREC>(static_cast<int64_t>(stamp - track.stamp)) * static_cast<PREC>(1e-9);
+        track.position += track.velocity * dt;
+        track.stamp = stamp;
+    }
+    return predicted;
+}
+
+template class ObjectTracker<float>;
+template class ObjectTracker<double>;
+} // namespace Xycar
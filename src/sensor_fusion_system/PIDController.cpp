@@ -1,6 +1,65 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
 #include "sensor_fusion_system/PIDController.hpp"
 namespace Xycar {
 
+template <typename PREC>
+PIDController<PREC>::PIDController(const std::vector<PREC>& speeds, const std::vector<Gains>& gains) : mSchedule(kScheduleSize)
+{
+    if (!isValidSchedule(speeds, gains))
+    {
+        // mSchedule is value initialized, so the controller steers straight rather than on garbage gains
+        std::cerr << "PID gain schedule needs one gain set per speed and strictly increasing speeds, using zero gains" << std::endl;
+        return;
+    }
+
+    mScheduleMin = speeds.front();
+    PREC scheduleMax = speeds.back();
+    mNodesPerSpeed = scheduleMax > mScheduleMin ? (kScheduleSize - 1) / (scheduleMax - mScheduleMin) : 0;
+
+    // resample the sparse schedule once, so setSpeed is a clamp and an index
+    size_t entry = 0;
+    for (int32_t i = 0; i < kScheduleSize; ++i)
+    {
+        PREC speed = mNodesPerSpeed > 0 ? mScheduleMin + i / mNodesPerSpeed : mScheduleMin;
+        while (entry + 1 < speeds.size() && speeds[entry + 1] <= speed)
+            ++entry;
+
+        if (entry + 1 == speeds.size())
+        {
+            mSchedule[i] = gains[entry];
+            continue;
+        }
+        PREC t = (speed - speeds[entry]) / (speeds[entry + 1] - speeds[entry]);
+        const Gains& low = gains[entry];
+        const Gains& high = gains[entry + 1];
+        mSchedule[i] = {low.proportional + (high.proportional - low.proportional) * t, low.integral + (high.integral - low.integral) * t,
+                        low.differential + (high.differential - low.differential) * t};
+    }
+}
+
+template <typename PREC>
+bool PIDController<PREC>::isValidSchedule(const std::vector<PREC>& speeds, const std::vector<Gains>& gains)
+{
+    if (speeds.empty() || speeds.size() != gains.size())
+        return false;
+    for (size_t i = 0; i < speeds.size(); ++i)
+    {
+        if (!std::isfinite(speeds[i]) || (i > 0 && speeds[i] <= speeds[i - 1]))
+            return false;
+    }
+    return true;
+}
+
+template <typename PREC>
+void PIDController<PREC>::setSpeed(PREC speed)
+{
+    PREC position = std::clamp((speed - mScheduleMin) * mNodesPerSpeed, static_cast<PREC>(0), static_cast<PREC>(kScheduleSize - 1));
+    mScheduleIndex = static_cast<int32_t>(position + static_cast<PREC>(0.5));
+}
+
 template <typename PREC>
 PREC PIDController<PREC>::getControlOutput(int32_t errorFromMid)
 {
@@ -8,9 +67,10 @@ PREC PIDController<PREC>::getControlOutput(int32_t errorFromMid)
     mDifferentialGainError = castError - mProportionalGainError;
     mProportionalGainError = castError;
     mIntegralGainError += castError;
-    return mProportionalGain * mProportionalGainError + mIntegralGain * mIntegralGainError + mDifferentialGain * mDifferentialGainError;
+    const Gains& gains = mSchedule[mScheduleIndex];
+    return gains.proportional * mProportionalGainError + gains.integral * mIntegralGainError + gains.differential * mDifferentialGainError;
 }
 
 template class PIDController<float>;
 template class PIDController<double>;
-} // namespace Xycar
\ No newline at end of file
+} // namespace Xycar
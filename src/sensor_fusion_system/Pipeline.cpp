@@ -0,0 +1,198 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file Pipeline.cpp
+ * @version 1.0
+ * @date 2024-02-21
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "sensor_fusion_system/Pipeline.hpp"
+
+namespace Xycar {
+
+bool Pipeline::configure(const YAML::Node& stages)
+{
+    mStages.clear();
+    mLevels.clear();
+
+    std::map<std::string, size_t> indices;
+    for (const YAML::Node& node : stages)
+    {
+        std::string name = node["NAME"].as<std::string>();
+        std::string type = node["TYPE"].as<std::string>();
+        auto function = mRegistry.find(type);
+        if (function == mRegistry.end() || indices.count(name) != 0)
+        {
+            std::cerr << "Pipeline: " << (function == mRegistry.end() ? "unknown stage type " + type : "duplicated stage " + name) << std::endl;
+            mStages.clear();
+            return false;
+        }
+        StageTrigger trigger = StageTrigger::DEPENDENCY;
+        int64_t period = 0;
+        std::string triggerName = node["TRIGGER"] ? node["TRIGGER"].as<std::string>() : "DEPENDENCY";
+        if (triggerName == "IMAGE")
+            trigger = StageTrigger::IMAGE;
+        else if (triggerName == "SCAN")
+            trigger = StageTrigger::SCAN;
+        else if (triggerName == "TIMER")
+        {
+            trigger = StageTrigger::TIMER;
+            period = static_cast<int64_t>(node["PERIOD"].as<double>() * 1e9);
+        }
+        else if (triggerName != "DEPENDENCY")
+        {
+            std::cerr << "Pipeline: unknown trigger " << triggerName << " of stage " << name << std::endl;
+            mStages.clear();
+            return false;
+        }
+
+        indices[name] = mStages.size();
+        mStages.push_back({name, function->second, {}, trigger, period, 0, 0.0, 0.0, 0});
+    }
+
+    for (const YAML::Node& node : stages)
+    {
+        Stage& stage = mStages[indices[node["NAME"].as<std::string>()]];
+        if (!node["AFTER"])
+            continue;
+        for (const YAML::Node& dependency : node["AFTER"])
+        {
+            auto found = indices.find(dependency.as<std::string>());
+            if (found == indices.end())
+            {
+                std::cerr << "Pipeline: " << stage.name << " depends on unknown stage " << dependency.as<std::string>() << std::endl;
+                mStages.clear();
+                return false;
+            }
+            stage.dependencies.push_back(found->second);
+        }
+    }
+
+    // level = longest dependency chain, assigned in rounds; a round without progress means a cycle
+    std::vector<int32_t> level(mStages.size(), -1);
+    size_t assigned = 0;
+    while (assigned < mStages.size())
+    {
+        std::vector<std::pair<size_t, int32_t>> ready;
+        for (size_t i = 0; i < mStages.size(); ++i)
+        {
+            if (level[i] >= 0)
+                continue;
+            int32_t depth = 0;
+            bool resolved = true;
+            for (size_t dependency : mStages[i].dependencies)
+            {
+                resolved = resolved && level[dependency] >= 0;
+                depth = std::max(depth, level[dependency] + 1);
+            }
+            if (resolved)
+                ready.emplace_back(i, depth);
+        }
+        if (ready.empty())
+        {
+            std::cerr << "Pipeline: dependency cycle" << std::endl;
+            mStages.clear();
+            mLevels.clear();
+            return false;
+        }
+        for (const auto& [stage, depth] : ready)
+        {
+            level[stage] = depth;
+            if (mLevels.size() <= static_cast<size_t>(depth))
+                mLevels.resize(depth + 1);
+            mLevels[depth].push_back(stage);
+        }
+        assigned += ready.size();
+    }
+
+    mSucceeded.assign(mStages.size(), 0);
+    mRan.assign(mStages.size(), 0);
+    mDurations.assign(mStages.size(), -1.f);
+    return true;
+}
+
+void Pipeline::run(uint32_t events)
+{
+    const int64_t iterationStart = now();
+    std::fill(mRan.begin(), mRan.end(), 0);
+    std::fill(mDurations.begin(), mDurations.end(), -1.f);
+    for (const std::vector<size_t>& stages : mLevels)
+    {
+        mTaskPool->parallelFor(stages.size(), [&](size_t i) {
+            Stage& stage = mStages[stages[i]];
+
+            bool triggered = false;
+            switch (stage.trigger)
+            {
+            case StageTrigger::IMAGE:
+                triggered = (events & kImageEvent) != 0;
+                break;
+            case StageTrigger::SCAN:
+                triggered = (events & kScanEvent) != 0;
+                break;
+            case StageTrigger::TIMER:
+                triggered = iterationStart - stage.lastStart >= stage.period;
+                break;
+            case StageTrigger::DEPENDENCY:
+                triggered = stage.dependencies.empty();
+                for (size_t dependency : stage.dependencies)
+                    triggered = triggered || (mRan[dependency] && mSucceeded[dependency]);
+                break;
+            }
+            if (!triggered)
+                return;
+
+            for (size_t dependency : stage.dependencies)
+            {
+                if (!mSucceeded[dependency])
+                    return;
+            }
+
+            // only this task touches the stage, the statistics need no lock
+            const int64_t start = now();
+            mSucceeded[stages[i]] = stage.function();
+            mRan[stages[i]] = 1;
+            const int64_t end = now();
+
+            const double duration = (end - start) * 1e-6;
+            mDurations[stages[i]] = static_cast<float>(duration);
+            stage.duration = stage.runs == 0 ? duration : stage.duration + kRateSmoothing * (duration - stage.duration);
+            if (stage.lastStart != 0 && start > stage.lastStart)
+            {
+                const double rate = 1e9 / (start - stage.lastStart);
+                stage.rate = stage.runs == 1 ? rate : stage.rate + kRateSmoothing * (rate - stage.rate);
+            }
+            stage.lastStart = start;
+            ++stage.runs;
+        });
+    }
+}
+
+bool Pipeline::succeeded(const std::string& name) const
+{
+    for (size_t i = 0; i < mStages.size(); ++i)
+    {
+        if (mStages[i].name == name)
+            return mSucceeded[i];
+    }
+    return false;
+}
+
+std::vector<StageStatistics> Pipeline::getStatistics() const
+{
+    std::vector<StageStatistics> statistics;
+    for (const Stage& stage : mStages)
+        statistics.push_back({stage.name, stage.rate, stage.duration, stage.runs});
+    return statistics;
+}
+
+int64_t Pipeline::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+} // namespace Xycar
@@ -0,0 +1,139 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file PoolMatAllocator.cpp
+ * @version 1.0
+ * @date 2024-02-22
+ */
+
+#include <cstdlib>
+#include <sys/mman.h>
+
+#include "sensor_fusion_system/PoolMatAllocator.hpp"
+
+namespace Xycar {
+
+PoolMatAllocator::PoolMatAllocator(bool hugePages, size_t maxCachedBytes) : mHugePages(hugePages), mMaxCachedBytes(maxCachedBytes) {}
+
+uint32_t PoolMatAllocator::getClassShift(size_t size)
+{
+    uint32_t shift = kMinClassShift;
+    while (shift <= kMaxClassShift && (static_cast<size_t>(1) << shift) < size)
+        ++shift;
+    return shift;
+}
+
+void* PoolMatAllocator::allocateBuffer(size_t size) const
+{
+    const bool huge = mHugePages && size >= (static_cast<size_t>(1) << kHugePageShift);
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, huge ? (static_cast<size_t>(1) << kHugePageShift) : kAlignment, size) != 0)
+        return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (huge)
+        madvise(buffer, size, MADV_HUGEPAGE);
+#endif
+    return buffer;
+}
+
+cv::UMatData* PoolMatAllocator::allocate(int dims, const int* sizes, int type, void* data0, size_t* step, MatAccessFlags /*flags*/,
+                                         cv::UMatUsageFlags /*usageFlags*/) const
+{
+    // same layout as cv::StdMatAllocator, only the buffer source differs
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; --i)
+    {
+        if (step)
+        {
+            if (data0 && step[i] != CV_AUTOSTEP)
+            {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            }
+            else
+                step[i] = total;
+        }
+        total *= sizes[i];
+    }
+
+    uchar* data = static_cast<uchar*>(data0);
+    if (data == nullptr)
+    {
+        mAllocations.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t shift = getClassShift(total);
+        if (shift > kMaxClassShift)
+        {
+            mLargeAllocations.fetch_add(1, std::memory_order_relaxed);
+            data = static_cast<uchar*>(allocateBuffer(total));
+        }
+        else
+        {
+            SizeClass& sizeClass = mClasses[shift];
+            {
+                std::lock_guard<std::mutex> lock(sizeClass.mutex);
+                if (!sizeClass.buffers.empty())
+                {
+                    data = static_cast<uchar*>(sizeClass.buffers.back());
+                    sizeClass.buffers.pop_back();
+                }
+            }
+            if (data != nullptr)
+            {
+                mPoolHits.fetch_add(1, std::memory_order_relaxed);
+                mCachedBytes.fetch_sub(static_cast<size_t>(1) << shift, std::memory_order_relaxed);
+            }
+            else
+                data = static_cast<uchar*>(allocateBuffer(static_cast<size_t>(1) << shift));
+        }
+        if (data == nullptr)
+            CV_Error(cv::Error::StsNoMem, "PoolMatAllocator: out of memory");
+    }
+
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0 != nullptr)
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    return u;
+}
+
+bool PoolMatAllocator::allocate(cv::UMatData* u, MatAccessFlags /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+    // host memory only, like cv::StdMatAllocator
+    return u != nullptr;
+}
+
+void PoolMatAllocator::deallocate(cv::UMatData* u) const
+{
+    if (u == nullptr)
+        return;
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+    {
+        const uint32_t shift = getClassShift(u->size);
+        const size_t classSize = static_cast<size_t>(1) << shift;
+        bool cached = false;
+        if (shift <= kMaxClassShift && mCachedBytes.load(std::memory_order_relaxed) + classSize <= mMaxCachedBytes)
+        {
+            SizeClass& sizeClass = mClasses[shift];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            sizeClass.buffers.push_back(u->origdata);
+            mCachedBytes.fetch_add(classSize, std::memory_order_relaxed);
+            cached = true;
+        }
+        if (!cached)
+            free(u->origdata);
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+PoolMatAllocatorStatistics PoolMatAllocator::getStatistics() const
+{
+    return {mAllocations.load(std::memory_order_relaxed), mPoolHits.load(std::memory_order_relaxed),
+            mLargeAllocations.load(std::memory_order_relaxed), mCachedBytes.load(std::memory_order_relaxed)};
+}
+} // namespace Xycar
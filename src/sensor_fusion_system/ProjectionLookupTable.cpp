@@ -0,0 +1,124 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ProjectionLookupTable.cpp
+ * @version 1.0
+ * @date 2024-02-13
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "sensor_fusion_system/ProjectionLookupTable.hpp"
+
+namespace Xycar {
+
+template <typename PREC>
+ProjectionLookupTable<PREC>::ProjectionLookupTable(PREC rangeMin, PREC rangeMax, uint32_t numRangeBins)
+    : mRangeMin(rangeMin), mRangeMax(rangeMax), mNumRangeBins(std::max<uint32_t>(numRangeBins, 2)),
+      mBinWidth((rangeMax - rangeMin) / static_cast<PREC>(mNumRangeBins - 1)), mInvBinWidth(1 / mBinWidth)
+{
+    assert(rangeMax > rangeMin);
+}
+
+template <typename PREC>
+void ProjectionLookupTable<PREC>::build(PREC angleMin, PREC angleIncrement, uint32_t numBeams, const ObjectPointFunction& toObjectPoint,
+                                        const cv::Mat& rvec, const cv::Mat& tvec, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs)
+{
+    std::vector<cv::Point3f> objectPoints;
+    objectPoints.reserve(static_cast<size_t>(numBeams) * mNumRangeBins);
+    for (uint32_t beam = 0; beam < numBeams; ++beam)
+    {
+        PREC angle = angleMin + static_cast<PREC>(beam) * angleIncrement;
+        for (uint32_t bin = 0; bin < mNumRangeBins; ++bin)
+            objectPoints.emplace_back(toObjectPoint(angle, getNodeRange(bin)));
+    }
+
+    cv::projectPoints(objectPoints, rvec, tvec, cameraMatrix, distCoeffs, mNodes);
+
+    // projectPoints happily mirrors points behind the camera into the image, so mark them explicitly
+    cv::Matx33d R;
+    cv::Rodrigues(rvec, R);
+    const double tz = tvec.at<double>(2, 0);
+    for (size_t i = 0; i < objectPoints.size(); ++i)
+    {
+        const cv::Point3f& p = objectPoints[i];
+        double zc = R(2, 0) * p.x + R(2, 1) * p.y + R(2, 2) * p.z + tz;
+        if (zc <= 0.0)
+            mNodes[i] = kInvalidPoint;
+    }
+
+    mAngleMin = angleMin;
+    mAngleIncrement = angleIncrement;
+    mNumBeams = numBeams;
+    mBuilt = true;
+}
+
+template <typename PREC>
+PREC ProjectionLookupTable<PREC>::validate(const ObjectPointFunction& toObjectPoint, const cv::Mat& rvec, const cv::Mat& tvec,
+                                           const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs) const
+{
+    if (!mBuilt)
+        return static_cast<PREC>(0);
+
+    std::vector<uint32_t> beams;
+    std::vector<PREC> ranges;
+    std::vector<cv::Point3f> objectPoints;
+    for (uint32_t beam = 0; beam < mNumBeams; ++beam)
+    {
+        PREC angle = mAngleMin + static_cast<PREC>(beam) * mAngleIncrement;
+        for (uint32_t bin = 0; bin + 1 < mNumRangeBins; ++bin)
+        {
+            PREC range = getNodeRange(bin) + mBinWidth / 2;
+            beams.push_back(beam);
+            ranges.push_back(range);
+            objectPoints.emplace_back(toObjectPoint(angle, range));
+        }
+    }
+
+    std::vector<cv::Point2f> exactPoints;
+    cv::projectPoints(objectPoints, rvec, tvec, cameraMatrix, distCoeffs, exactPoints);
+
+    PREC maxError = 0;
+    for (size_t i = 0; i < exactPoints.size(); ++i)
+    {
+        cv::Point2f tablePoint;
+        if (!lookup(beams[i], ranges[i], tablePoint))
+            continue;
+
+        cv::Point2f diff = tablePoint - exactPoints[i];
+        maxError = std::max(maxError, static_cast<PREC>(std::sqrt(diff.dot(diff))));
+    }
+    return maxError;
+}
+
+template <typename PREC>
+bool ProjectionLookupTable<PREC>::lookup(uint32_t beamIndex, PREC range, cv::Point2f& imagePoint) const
+{
+    if (beamIndex >= mNumBeams || !covers(range))
+        return false;
+
+    PREC position = (range - mRangeMin) * mInvBinWidth;
+    uint32_t bin = std::min(static_cast<uint32_t>(position), mNumRangeBins - 2);
+    float t = static_cast<float>(position - static_cast<PREC>(bin));
+
+    const cv::Point2f& near = mNodes[static_cast<size_t>(beamIndex) * mNumRangeBins + bin];
+    const cv::Point2f& far = mNodes[static_cast<size_t>(beamIndex) * mNumRangeBins + bin + 1];
+    if (near == kInvalidPoint || far == kInvalidPoint)
+        return false;
+
+    imagePoint = cv::Point2f(near.x + (far.x - near.x) * t, near.y + (far.y - near.y) * t);
+    return true;
+}
+
+template <typename PREC>
+bool ProjectionLookupTable<PREC>::isBuiltFor(PREC angleMin, PREC angleIncrement, uint32_t numBeams) const
+{
+    return mBuilt && mAngleMin == angleMin && mAngleIncrement == angleIncrement && mNumBeams == numBeams;
+}
+
+template class ProjectionLookupTable<float>;
+template class ProjectionLookupTable<double>;
+} // namespace Xycar
@@ -0,0 +1,30 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sensor_fusion_system/PurePursuitController.hpp"
+namespace Xycar {
+
+template <typename PREC>
+PurePursuitController<PREC>::PurePursuitController(PREC metersPerPixel, PREC lookahead, PREC wheelbase, PREC commandPerDegree, int32_t maxError,
+                                                   int32_t steeringLimit)
+    : mMaxError(maxError)
+{
+    mSteering.resize(2 * mMaxError + 1);
+    for (int32_t error = -mMaxError; error <= mMaxError; ++error)
+    {
+        PREC lateral = error * metersPerPixel;
+        PREC curvature = 2 * lateral / (lookahead * lookahead + lateral * lateral);
+        PREC wheelAngle = std::atan(wheelbase * curvature) * static_cast<PREC>(180.0 / M_PI);
+        mSteering[error + mMaxError] = std::clamp<PREC>(wheelAngle * commandPerDegree, -steeringLimit, steeringLimit);
+    }
+}
+
+template <typename PREC>
+PREC PurePursuitController<PREC>::getControlOutput(int32_t errorFromMid)
+{
+    return mSteering[std::clamp(errorFromMid, -mMaxError, mMaxError) + mMaxError];
+}
+
+template class PurePursuitController<float>;
+template class PurePursuitController<double>;
+} // namespace Xycar
@@ -0,0 +1,228 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file Recorder.cpp
+ * @version 1.0
+ * @date 2024-02-14
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "sensor_fusion_system/Recorder.hpp"
+
+namespace Xycar {
+namespace {
+constexpr char kMagic[6] = {'X', 'Y', 'R', 'E', 'C', '1'};
+
+template <typename T>
+void appendRaw(std::vector<uint8_t>& out, const T& value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool readRaw(const std::vector<uint8_t>& in, size_t& offset, T& value)
+{
+    if (offset + sizeof(T) > in.size())
+        return false;
+    std::memcpy(&value, in.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+void appendVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool readVarint(const std::vector<uint8_t>& in, size_t& offset, uint32_t& value)
+{
+    value = 0;
+    for (int32_t shift = 0; shift < 35 && offset < in.size(); shift += 7)
+    {
+        uint8_t byte = in[offset++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline uint32_t zigzag(int32_t value) { return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31); }
+inline int32_t unzigzag(uint32_t value) { return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1); }
+} // namespace
+
+Recorder::Recorder(const std::string& path, FrameCodec codec, int32_t jpegQuality, uint32_t queueSize)
+    : mFile(path, std::ios::binary | std::ios::trunc), mCodec(codec), mJpegQuality(jpegQuality), mQueue(queueSize)
+{
+    if (!mFile.is_open())
+        std::cerr << "Recorder could not open " << path << std::endl;
+    mFile.write(kMagic, sizeof(kMagic));
+    mWorker = std::thread(&Recorder::work, this);
+}
+
+Recorder::~Recorder()
+{
+    mSignal.stop();
+    mWorker.join();
+}
+
+void Recorder::addFrame(uint64_t stamp, const cv::Mat& frame)
+{
+    Pending pending;
+    pending.type = RecordType::FRAME;
+    pending.stamp = stamp;
+    pending.frame = frame.clone();
+    // never block the callbacks, the oldest data is the least useful
+    mQueue.push(std::move(pending));
+    mSignal.notify();
+}
+
+void Recorder::addScan(uint64_t stamp, float angleMin, float angleIncrement, const std::vector<float>& ranges)
+{
+    Pending pending;
+    pending.type = RecordType::SCAN;
+    pending.stamp = stamp;
+    pending.angleMin = angleMin;
+    pending.angleIncrement = angleIncrement;
+    pending.ranges = ranges;
+    mQueue.push(std::move(pending));
+    mSignal.notify();
+}
+
+void Recorder::work()
+{
+    Record record;
+    Pending pending;
+    while (true)
+    {
+        if (!mQueue.pop(pending))
+        {
+            if (!mSignal.isRunning())
+            {
+                // stopping, but write everything queued before the destructor was called
+                if (!mQueue.pop(pending))
+                    return;
+            }
+            else
+            {
+                mSignal.prepareWait();
+                if (!mQueue.pop(pending))
+                {
+                    mSignal.commitWait();
+                    continue;
+                }
+                mSignal.cancelWait();
+            }
+        }
+
+        record.type = pending.type;
+        record.stamp = pending.stamp;
+        record.payload.clear();
+        if (pending.type == RecordType::FRAME)
+            encodeFrame(pending.frame, mCodec, mJpegQuality, record.payload);
+        else
+            encodeScan(pending.angleMin, pending.angleIncrement, pending.ranges, record.payload);
+        write(record);
+    }
+}
+
+void Recorder::write(const Record& record)
+{
+    uint8_t type = static_cast<uint8_t>(record.type);
+    uint32_t size = static_cast<uint32_t>(record.payload.size());
+    mFile.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    mFile.write(reinterpret_cast<const char*>(&record.stamp), sizeof(record.stamp));
+    mFile.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    mFile.write(reinterpret_cast<const char*>(record.payload.data()), size);
+}
+
+void Recorder::encodeScan(float angleMin, float angleIncrement, const std::vector<float>& ranges, std::vector<uint8_t>& payload)
+{
+    appendRaw(payload, angleMin);
+    appendRaw(payload, angleIncrement);
+    appendRaw(payload, static_cast<uint32_t>(ranges.size()));
+
+    // neighbouring beams mostly hit the same surface, so deltas usually fit in one varint byte
+    int32_t previous = 0;
+    for (float range : ranges)
+    {
+        float scaled = range / kRangeScale;
+        int32_t quantized = (std::isfinite(scaled) && scaled >= 0.f && scaled < kInvalidRange) ? static_cast<int32_t>(std::lround(scaled)) : kInvalidRange;
+        quantized = std::min<int32_t>(quantized, kInvalidRange);
+        appendVarint(payload, zigzag(quantized - previous));
+        previous = quantized;
+    }
+}
+
+bool Recorder::decodeScan(const std::vector<uint8_t>& payload, float& angleMin, float& angleIncrement, std::vector<float>& ranges)
+{
+    size_t offset = 0;
+    uint32_t count = 0;
+    if (!readRaw(payload, offset, angleMin) || !readRaw(payload, offset, angleIncrement) || !readRaw(payload, offset, count))
+        return false;
+
+    ranges.resize(count);
+    int32_t previous = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t delta;
+        if (!readVarint(payload, offset, delta))
+            return false;
+        previous += unzigzag(delta);
+        ranges[i] = previous == kInvalidRange ? std::numeric_limits<float>::infinity() : previous * kRangeScale;
+    }
+    return true;
+}
+
+void Recorder::encodeFrame(const cv::Mat& frame, FrameCodec codec, int32_t jpegQuality, std::vector<uint8_t>& payload)
+{
+    if (codec == FrameCodec::JPEG)
+        cv::imencode(".jpg", frame, payload, {cv::IMWRITE_JPEG_QUALITY, jpegQuality});
+    else
+        cv::imencode(".png", frame, payload);
+}
+
+bool Recorder::decodeFrame(const std::vector<uint8_t>& payload, cv::Mat& frame)
+{
+    frame = cv::imdecode(payload, cv::IMREAD_COLOR);
+    return !frame.empty();
+}
+
+RecordReader::RecordReader(const std::string& path) : mFile(path, std::ios::binary)
+{
+    char magic[sizeof(kMagic)] = {};
+    mFile.read(magic, sizeof(magic));
+    mValid = mFile.good() && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool RecordReader::next(Record& record)
+{
+    if (!mValid)
+        return false;
+
+    uint8_t type = 0;
+    uint32_t size = 0;
+    mFile.read(reinterpret_cast<char*>(&type), sizeof(type));
+    mFile.read(reinterpret_cast<char*>(&record.stamp), sizeof(record.stamp));
+    mFile.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!mFile.good())
+        return false;
+
+    record.type = static_cast<RecordType>(type);
+    record.payload.resize(size);
+    mFile.read(reinterpret_cast<char*>(record.payload.data()), size);
+    return mFile.good();
+}
+} // namespace Xycar
@@ -0,0 +1,282 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ResultsLog.cpp
+ * @version 1.0
+ * @date 2024-02-28
+ */
+
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+
+#include "sensor_fusion_system/ResultsLog.hpp"
+
+namespace Xycar {
+namespace {
+constexpr char kMagic[6] = {'X', 'Y', 'L', 'O', 'G', '1'};
+
+#define XYCAR_COLUMN(ROW, FIELD, NAME, TYPE) {NAME, ColumnType::TYPE, offsetof(ROW, FIELD), sizeof(ROW::FIELD)}
+
+// the storage order is the export order, append new columns at the end and bump the magic
+const ColumnSchema kFrameColumns[] = {
+    XYCAR_COLUMN(FrameRow, frameId, "frame_id", U64),
+    XYCAR_COLUMN(FrameRow, stamp, "stamp", U64),
+    XYCAR_COLUMN(FrameRow, scanStamp, "scan_stamp", U64),
+    XYCAR_COLUMN(FrameRow, detectionLatency, "detection_latency_ms", F32),
+    XYCAR_COLUMN(FrameRow, iterationDuration, "iteration_ms", F32),
+    XYCAR_COLUMN(FrameRow, numBoxes, "num_boxes", U32),
+    XYCAR_COLUMN(FrameRow, numTracks, "num_tracks", U32),
+    XYCAR_COLUMN(FrameRow, steeringAngle, "steering_angle", F32),
+    XYCAR_COLUMN(FrameRow, speed, "speed", F32),
+    XYCAR_COLUMN(FrameRow, emergencyStop, "emergency_stop", U8),
+};
+
+const ColumnSchema kBoxColumns[] = {
+    XYCAR_COLUMN(BoxRow, frameId, "frame_id", U64),
+    XYCAR_COLUMN(BoxRow, classId, "class_id", I32),
+    XYCAR_COLUMN(BoxRow, confidence, "confidence", F32),
+    XYCAR_COLUMN(BoxRow, x, "x", I32),
+    XYCAR_COLUMN(BoxRow, y, "y", I32),
+    XYCAR_COLUMN(BoxRow, width, "width", I32),
+    XYCAR_COLUMN(BoxRow, height, "height", I32),
+    XYCAR_COLUMN(BoxRow, numPoints, "num_points", U32),
+    XYCAR_COLUMN(BoxRow, distance, "distance", F32),
+    XYCAR_COLUMN(BoxRow, rangeSource, "range_source", U8),
+};
+
+const ColumnSchema kStageColumns[] = {
+    XYCAR_COLUMN(StageRow, frameId, "frame_id", U64),
+    XYCAR_COLUMN(StageRow, stage, "stage", U32),
+    XYCAR_COLUMN(StageRow, duration, "duration_ms", F32),
+};
+
+const ColumnSchema kObjectColumns[] = {
+    XYCAR_COLUMN(ObjectRow, frameId, "frame_id", U64),
+    XYCAR_COLUMN(ObjectRow, stamp, "stamp", U64),
+    XYCAR_COLUMN(ObjectRow, pass, "pass", U8),
+    XYCAR_COLUMN(ObjectRow, classId, "class_id", I32),
+    XYCAR_COLUMN(ObjectRow, x, "x", F32),
+    XYCAR_COLUMN(ObjectRow, y, "y", F32),
+    XYCAR_COLUMN(ObjectRow, rangeSource, "range_source", U8),
+};
+
+#undef XYCAR_COLUMN
+
+template <size_t N>
+TableSchema makeSchema(const ColumnSchema (&columns)[N])
+{
+    size_t rowSize = 0;
+    for (const ColumnSchema& column : columns)
+        rowSize += column.size;
+    return {columns, N, rowSize};
+}
+} // namespace
+
+TableSchema getTableSchema(LogTable table)
+{
+    switch (table)
+    {
+    case LogTable::FRAMES:
+        return makeSchema(kFrameColumns);
+    case LogTable::BOXES:
+        return makeSchema(kBoxColumns);
+    case LogTable::STAGES:
+        return makeSchema(kStageColumns);
+    case LogTable::OBJECTS:
+        return makeSchema(kObjectColumns);
+    default:
+        return {nullptr, 0, 0};
+    }
+}
+
+ResultsLog::ResultsLog(const std::string& path, const std::vector<std::string>& stageNames, uint32_t blockRows, int32_t compressionLevel,
+                       uint32_t queueSize)
+    : mFile(path, std::ios::binary | std::ios::trunc), mBlockRows(blockRows), mCompressionLevel(compressionLevel), mQueue(queueSize)
+{
+    if (!mFile.is_open())
+        std::cerr << "Results log could not open " << path << std::endl;
+    mFile.write(kMagic, sizeof(kMagic));
+
+    std::vector<uint8_t> names;
+    for (const std::string& name : stageNames)
+    {
+        names.insert(names.end(), name.begin(), name.end());
+        names.push_back('\n');
+    }
+    writeBlock(LogTable::STAGE_NAMES, static_cast<uint32_t>(stageNames.size()), names, names);
+
+    mWorker = std::thread(&ResultsLog::work, this);
+}
+
+ResultsLog::~ResultsLog()
+{
+    mSignal.stop();
+    mWorker.join();
+}
+
+void ResultsLog::add(const FrameRow& frame, const std::vector<BoxRow>& boxes, const std::vector<float>& stageDurations)
+{
+    Pending pending;
+    pending.hasFrame = true;
+    pending.frame = frame;
+    pending.boxes = boxes;
+    for (size_t i = 0; i < stageDurations.size(); ++i)
+    {
+        if (stageDurations[i] >= 0)
+            pending.stages.push_back({frame.frameId, static_cast<uint32_t>(i), stageDurations[i]});
+    }
+    // never block the pipeline, the oldest frames are the least useful
+    mQueue.push(std::move(pending));
+    mSignal.notify();
+}
+
+void ResultsLog::add(const std::vector<ObjectRow>& objects)
+{
+    if (objects.empty())
+        return;
+    Pending pending;
+    pending.objects = objects;
+    mQueue.push(std::move(pending));
+    mSignal.notify();
+}
+
+void ResultsLog::work()
+{
+    Pending pending;
+    while (true)
+    {
+        if (!mQueue.pop(pending))
+        {
+            if (!mSignal.isRunning())
+            {
+                // stopping, write everything queued before the destructor was called and the partial blocks
+                if (!mQueue.pop(pending))
+                    break;
+            }
+            else
+            {
+                mSignal.prepareWait();
+                if (!mQueue.pop(pending))
+                {
+                    mSignal.commitWait();
+                    continue;
+                }
+                mSignal.cancelWait();
+            }
+        }
+
+        if (pending.hasFrame)
+            append(mFrames, &pending.frame, sizeof(FrameRow));
+        for (const BoxRow& box : pending.boxes)
+            append(mBoxes, &box, sizeof(BoxRow));
+        for (const StageRow& stage : pending.stages)
+            append(mStages, &stage, sizeof(StageRow));
+        for (const ObjectRow& object : pending.objects)
+            append(mObjects, &object, sizeof(ObjectRow));
+    }
+
+    flush(mFrames);
+    flush(mBoxes);
+    flush(mStages);
+    flush(mObjects);
+    mFile.flush();
+}
+
+void ResultsLog::append(TableBuffer& buffer, const void* row, size_t rowSize)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(row);
+    buffer.rows.insert(buffer.rows.end(), bytes, bytes + rowSize);
+    if (++buffer.numRows >= mBlockRows)
+        flush(buffer);
+}
+
+void ResultsLog::flush(TableBuffer& buffer)
+{
+    if (buffer.numRows == 0)
+        return;
+
+    // rows to columns: values of one column are similar, which is what makes the block compress well
+    const TableSchema schema = getTableSchema(buffer.table);
+    const size_t structSize = buffer.rows.size() / buffer.numRows;
+    mColumns.resize(schema.rowSize * buffer.numRows);
+    uint8_t* out = mColumns.data();
+    for (size_t c = 0; c < schema.numColumns; ++c)
+    {
+        const ColumnSchema& column = schema.columns[c];
+        const uint8_t* in = buffer.rows.data() + column.offset;
+        for (uint32_t r = 0; r < buffer.numRows; ++r, in += structSize, out += column.size)
+            std::memcpy(out, in, column.size);
+    }
+
+    uLongf storedSize = compressBound(static_cast<uLong>(mColumns.size()));
+    mCompressed.resize(storedSize);
+    if (compress2(mCompressed.data(), &storedSize, mColumns.data(), static_cast<uLong>(mColumns.size()), mCompressionLevel) == Z_OK)
+    {
+        mCompressed.resize(storedSize);
+        writeBlock(buffer.table, buffer.numRows, mColumns, mCompressed);
+    }
+    else
+        std::cerr << "Results log could not compress a block, " << buffer.numRows << " rows lost" << std::endl;
+
+    buffer.rows.clear();
+    buffer.numRows = 0;
+}
+
+void ResultsLog::writeBlock(LogTable table, uint32_t rows, const std::vector<uint8_t>& raw, const std::vector<uint8_t>& stored)
+{
+    uint8_t type = static_cast<uint8_t>(table);
+    uint32_t rawSize = static_cast<uint32_t>(raw.size());
+    uint32_t storedSize = static_cast<uint32_t>(stored.size());
+    mFile.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    mFile.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    mFile.write(reinterpret_cast<const char*>(&rawSize), sizeof(rawSize));
+    mFile.write(reinterpret_cast<const char*>(&storedSize), sizeof(storedSize));
+    mFile.write(reinterpret_cast<const char*>(stored.data()), storedSize);
+}
+
+ResultsLogReader::ResultsLogReader(const std::string& path) : mFile(path, std::ios::binary)
+{
+    char magic[sizeof(kMagic)] = {};
+    mFile.read(magic, sizeof(magic));
+    mValid = mFile.good() && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool ResultsLogReader::next(LogBlock& block)
+{
+    if (!mValid)
+        return false;
+
+    uint8_t type = 0;
+    uint32_t rawSize = 0;
+    uint32_t storedSize = 0;
+    mFile.read(reinterpret_cast<char*>(&type), sizeof(type));
+    mFile.read(reinterpret_cast<char*>(&block.rows), sizeof(block.rows));
+    mFile.read(reinterpret_cast<char*>(&rawSize), sizeof(rawSize));
+    mFile.read(reinterpret_cast<char*>(&storedSize), sizeof(storedSize));
+    if (!mFile.good())
+        return false;
+
+    block.table = static_cast<LogTable>(type);
+    mStored.resize(storedSize);
+    mFile.read(reinterpret_cast<char*>(mStored.data()), storedSize);
+    if (!mFile.good())
+        return false;
+
+    if (block.table == LogTable::STAGE_NAMES)
+    {
+        block.data = mStored;
+        return true;
+    }
+
+    // a block must hold exactly rows values of every column of its schema
+    const TableSchema schema = getTableSchema(block.table);
+    if (schema.numColumns == 0 || rawSize != schema.rowSize * block.rows)
+        return false;
+
+    block.data.resize(rawSize);
+    uLongf size = rawSize;
+    return uncompress(block.data.data(), &size, mStored.data(), storedSize) == Z_OK && size == rawSize;
+}
+} // namespace Xycar
@@ -0,0 +1,188 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ScanFilter.cpp
+ * @version 1.0
+ * @date 2024-02-13
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "sensor_fusion_system/ScanFilter.hpp"
+
+namespace Xycar {
+namespace {
+constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+
+// Ternaries instead of std::min/max so the loops below compile to packed min/max instructions
+inline float minOf(float a, float b) { return b < a ? b : a; }
+inline float maxOf(float a, float b) { return b < a ? a : b; }
+
+inline float median3(float a, float b, float c) { return maxOf(minOf(a, b), minOf(maxOf(a, b), c)); }
+
+inline float median5(float a, float b, float c, float d, float e)
+{
+    // Sort (a, b) and (c, d), drop the smallest of the two minima and the largest of the two maxima,
+    // then the median of the remaining three values and e is the median of all five
+    float lo1 = minOf(a, b), hi1 = maxOf(a, b);
+    float lo2 = minOf(c, d), hi2 = maxOf(c, d);
+    float lo = maxOf(lo1, lo2);
+    float hi = minOf(hi1, hi2);
+    return median3(lo, hi, e);
+}
+} // namespace
+
+template <typename PREC>
+void MedianScanFilter<PREC>::apply(std::vector<float>& ranges, PREC /*angleIncrement*/)
+{
+    const int32_t n = static_cast<int32_t>(ranges.size());
+    const int32_t h = static_cast<int32_t>(mHalfWindow);
+    if (h == 0 || n <= 2 * h)
+        return;
+
+    mScratch.assign(ranges.begin(), ranges.end());
+    const float* __restrict in = mScratch.data();
+    float* __restrict out = ranges.data();
+
+    // Borders keep their raw value
+    if (h == 1)
+    {
+        for (int32_t i = 1; i < n - 1; ++i)
+            out[i] = median3(in[i - 1], in[i], in[i + 1]);
+    }
+    else if (h == 2)
+    {
+        for (int32_t i = 2; i < n - 2; ++i)
+            out[i] = median5(in[i - 2], in[i - 1], in[i], in[i + 1], in[i + 2]);
+    }
+    else
+    {
+        mWindow.resize(2 * h + 1);
+        for (int32_t i = h; i < n - h; ++i)
+        {
+            std::copy(in + i - h, in + i + h + 1, mWindow.begin());
+            std::nth_element(mWindow.begin(), mWindow.begin() + h, mWindow.end());
+            out[i] = mWindow[h];
+        }
+    }
+}
+
+template <typename PREC>
+void IsolatedPointScanFilter<PREC>::apply(std::vector<float>& ranges, PREC /*angleIncrement*/)
+{
+    const int32_t n = static_cast<int32_t>(ranges.size());
+    if (n < 3)
+        return;
+
+    mScratch.assign(ranges.begin(), ranges.end());
+    const float* __restrict in = mScratch.data();
+    float* __restrict out = ranges.data();
+    const float threshold = mThreshold;
+
+    for (int32_t i = 1; i < n - 1; ++i)
+    {
+        bool isolated = std::abs(in[i] - in[i - 1]) > threshold && std::abs(in[i] - in[i + 1]) > threshold;
+        out[i] = isolated ? kNaN : in[i];
+    }
+}
+
+template <typename PREC>
+ShadowScanFilter<PREC>::ShadowScanFilter(PREC minAngle, PREC maxAngle, uint32_t window)
+    : mTanMinAngle(static_cast<float>(std::tan(minAngle * M_PI / 180.0))), mTanMaxAngle(static_cast<float>(std::tan(maxAngle * M_PI / 180.0))),
+      mWindow(window)
+{
+}
+
+template <typename PREC>
+void ShadowScanFilter<PREC>::apply(std::vector<float>& ranges, PREC angleIncrement)
+{
+    const int32_t n = static_cast<int32_t>(ranges.size());
+    const int32_t w = static_cast<int32_t>(mWindow);
+    if (w == 0 || n <= w)
+        return;
+
+    if (mSin.size() != mWindow || angleIncrement != mAngleIncrement)
+    {
+        mAngleIncrement = angleIncrement;
+        mSin.resize(mWindow);
+        mCos.resize(mWindow);
+        for (uint32_t k = 0; k < mWindow; ++k)
+        {
+            mSin[k] = static_cast<float>(std::sin((k + 1) * angleIncrement));
+            mCos[k] = static_cast<float>(std::cos((k + 1) * angleIncrement));
+        }
+    }
+
+    mRemove.assign(n, 0);
+    const float* __restrict r = ranges.data();
+    uint8_t* __restrict remove = mRemove.data();
+    const float tanMin = mTanMinAngle;
+    const float tanMax = mTanMaxAngle;
+
+    // Same test as laser_filters' ScanShadowsFilter, on tangents so no atan2 is needed:
+    // the surface through two returns is too oblique when its angle to the beam is outside [min, max]
+    auto isShadow = [tanMin, tanMax](float r1, float r2, float s, float c) {
+        float perpendicularY = r2 * s;
+        float perpendicularX = r1 - r2 * c;
+        float perpendicularTan = std::abs(perpendicularY) / perpendicularX;
+        return perpendicularTan > 0 ? perpendicularTan < tanMin : perpendicularTan > tanMax;
+    };
+
+    for (int32_t k = 1; k <= w; ++k)
+    {
+        const float s = mSin[k - 1];
+        const float c = mCos[k - 1];
+        for (int32_t i = 0; i < n - k; ++i)
+        {
+            const float a = r[i];
+            const float b = r[i + k];
+            bool shadow = isShadow(a, b, s, c) || isShadow(b, a, s, c);
+            // the veiling point is the farther one of the pair
+            remove[i] |= static_cast<uint8_t>(shadow && a > b);
+            remove[i + k] |= static_cast<uint8_t>(shadow && b > a);
+        }
+    }
+
+    float* __restrict out = ranges.data();
+    for (int32_t i = 0; i < n; ++i)
+        out[i] = remove[i] ? kNaN : out[i];
+}
+
+template <typename PREC>
+ScanFilterChain<PREC>::ScanFilterChain(const YAML::Node& config)
+{
+    for (const auto& filter : config)
+    {
+        std::string type = filter["TYPE"].as<std::string>();
+        if (type == "MEDIAN")
+            mFilters.push_back(new MedianScanFilter<PREC>(filter["WINDOW"].as<uint32_t>()));
+        else if (type == "ISOLATED_POINT")
+            mFilters.push_back(new IsolatedPointScanFilter<PREC>(filter["THRESHOLD"].as<PREC>()));
+        else if (type == "SHADOW")
+            mFilters.push_back(new ShadowScanFilter<PREC>(filter["MIN_ANGLE"].as<PREC>(), filter["MAX_ANGLE"].as<PREC>(), filter["WINDOW"].as<uint32_t>()));
+        else
+            std::cerr << "Unknown scan filter type: " << type << std::endl;
+    }
+}
+
+template <typename PREC>
+ScanFilterChain<PREC>::~ScanFilterChain()
+{
+    for (auto filter : mFilters)
+        delete filter;
+}
+
+template <typename PREC>
+void ScanFilterChain<PREC>::apply(std::vector<float>& ranges, PREC angleIncrement)
+{
+    for (auto filter : mFilters)
+        filter->apply(ranges, angleIncrement);
+}
+
+template class ScanFilterChain<float>;
+template class ScanFilterChain<double>;
+} // namespace Xycar
@@ -0,0 +1,170 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file ScanSegmenter.cpp
+ * @version 1.0
+ * @date 2024-02-25
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "sensor_fusion_system/ScanSegmenter.hpp"
+
+namespace Xycar {
+
+template <typename PREC>
+void ScanSegmenter<PREC>::setLidarToVCS(const cv::Point_<PREC>& origin, const cv::Point_<PREC>& xAxis, const cv::Point_<PREC>& yAxis)
+{
+    mOrigin = origin;
+    mXAxis = xAxis;
+    mYAxis = yAxis;
+}
+
+template <typename PREC>
+void ScanSegmenter<PREC>::updateGeometry(PREC angleMin, PREC angleIncrement, uint32_t numBeams)
+{
+    if (angleMin == mAngleMin && angleIncrement == mAngleIncrement && numBeams == mNumBeams)
+        return;
+    mAngleMin = angleMin;
+    mAngleIncrement = angleIncrement;
+    mNumBeams = numBeams;
+
+    mCos.resize(numBeams);
+    mSin.resize(numBeams);
+    for (uint32_t i = 0; i < numBeams; ++i)
+    {
+        mCos[i] = std::cos(angleMin + i * angleIncrement);
+        mSin[i] = std::sin(angleMin + i * angleIncrement);
+    }
+    mFullCircle = std::abs(numBeams * angleIncrement - static_cast<PREC>(2 * M_PI)) < static_cast<PREC>(1.5) * std::abs(angleIncrement);
+    mAdjacentFactor = std::sin(std::abs(angleIncrement)) / std::sin(mLambda - std::abs(angleIncrement));
+}
+
+template <typename PREC>
+void ScanSegmenter<PREC>::segment(const std::vector<float>& ranges, PREC angleMin, PREC angleIncrement)
+{
+    const uint32_t numBeams = static_cast<uint32_t>(ranges.size());
+    updateGeometry(angleMin, angleIncrement, numBeams);
+    mSegments.clear();
+    mBeamSegment.assign(numBeams, -1);
+    if (numBeams == 0)
+        return;
+
+    auto isValid = [&](uint32_t i) { return std::isfinite(ranges[i]) && ranges[i] > 0 && ranges[i] <= mMaxRange; };
+    auto isBreak = [&](uint32_t previous, PREC previousRange, uint32_t i) {
+        PREC dphi = std::abs(angleIncrement) * ((i + numBeams - previous) % numBeams);
+        if (dphi >= mLambda)
+            return true;
+        PREC factor = (i + numBeams - previous) % numBeams == 1 ? mAdjacentFactor : std::sin(dphi) / std::sin(mLambda - dphi);
+        PREC dx = ranges[i] * mCos[i] - previousRange * mCos[previous];
+        PREC dy = ranges[i] * mSin[i] - previousRange * mSin[previous];
+        PREC maxGap = previousRange * factor + 3 * mSigma;
+        return dx * dx + dy * dy > maxGap * maxGap;
+    };
+
+    // a full circle has no natural start, begin right after the first breakpoint
+    uint32_t start = 0;
+    if (mFullCircle)
+    {
+        int64_t previous = -1;
+        for (uint32_t i = 0; i < numBeams; ++i)
+        {
+            if (!isValid(i))
+                continue;
+            if (previous >= 0 && isBreak(static_cast<uint32_t>(previous), ranges[previous], i))
+            {
+                start = i;
+                break;
+            }
+            previous = i;
+        }
+    }
+
+    Accumulator open = {};
+    uint32_t previous = 0;
+    for (uint32_t step = 0; step < numBeams; ++step)
+    {
+        const uint32_t i = (start + step) % numBeams;
+        if (!isValid(i))
+            continue;
+
+        if (open.count > 0 && isBreak(previous, ranges[previous], i))
+        {
+            close(open);
+            open = {};
+        }
+
+        cv::Point_<PREC> point(ranges[i] * mCos[i], ranges[i] * mSin[i]);
+        if (open.count == 0)
+        {
+            open.firstBeam = i;
+            open.first = point;
+        }
+        open.lastBeam = i;
+        open.last = point;
+        ++open.count;
+        open.sx += point.x;
+        open.sy += point.y;
+        open.sxx += point.x * point.x;
+        open.syy += point.y * point.y;
+        open.sxy += point.x * point.y;
+        previous = i;
+    }
+    if (open.count > 0)
+        close(open);
+}
+
+template <typename PREC>
+void ScanSegmenter<PREC>::close(const Accumulator& open)
+{
+    if (open.count < mMinPoints)
+        return;
+
+    // total least squares line through the centroid, endpoints are the first and last point projected on it
+    const PREC n = static_cast<PREC>(open.count);
+    const cv::Point_<PREC> centroid(open.sx / n, open.sy / n);
+    const PREC cxx = open.sxx / n - centroid.x * centroid.x;
+    const PREC cyy = open.syy / n - centroid.y * centroid.y;
+    const PREC cxy = open.sxy / n - centroid.x * centroid.y;
+    const PREC theta = static_cast<PREC>(0.5) * std::atan2(2 * cxy, cxx - cyy);
+    const cv::Point_<PREC> direction(std::cos(theta), std::sin(theta));
+    auto project = [&](const cv::Point_<PREC>& point) { return centroid + direction * (point - centroid).dot(direction); };
+
+    const int32_t index = static_cast<int32_t>(mSegments.size());
+    mSegments.push_back({toVCS(project(open.first)), toVCS(project(open.last)), toVCS(centroid), open.firstBeam, open.lastBeam, open.count, -1, 0.f});
+    for (uint32_t i = open.firstBeam;; i = (i + 1) % mNumBeams)
+    {
+        mBeamSegment[i] = index;
+        if (i == open.lastBeam)
+            break;
+    }
+}
+
+template <typename PREC>
+int32_t ScanSegmenter<PREC>::label(const std::vector<int>& beams, int32_t classId, float confidence)
+{
+    mVotes.assign(mSegments.size(), 0);
+    for (int beam : beams)
+    {
+        if (beam >= 0 && static_cast<size_t>(beam) < mBeamSegment.size() && mBeamSegment[beam] >= 0)
+            ++mVotes[mBeamSegment[beam]];
+    }
+
+    auto best = std::max_element(mVotes.begin(), mVotes.end());
+    if (best == mVotes.end() || *best == 0)
+        return -1;
+
+    ScanSegment<PREC>& segment = mSegments[best - mVotes.begin()];
+    if (segment.classId < 0 || confidence > segment.confidence)
+    {
+        segment.classId = classId;
+        segment.confidence = confidence;
+    }
+    return static_cast<int32_t>(best - mVotes.begin());
+}
+
+template class ScanSegmenter<float>;
+template class ScanSegmenter<double>;
+} // namespace Xycar
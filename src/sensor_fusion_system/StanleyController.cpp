@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sensor_fusion_system/StanleyController.hpp"
+namespace Xycar {
+
+template <typename PREC>
+StanleyController<PREC>::StanleyController(PREC metersPerPixel, PREC gain, PREC softeningSpeed, PREC speedToMps, PREC commandPerDegree,
+                                           int32_t steeringLimit)
+    : mMetersPerPixel(metersPerPixel), mGain(gain), mSofteningSpeed(softeningSpeed), mSpeedToMps(speedToMps)
+{
+    // beyond the argument that saturates the steering, every command is the limit, so the table stops there
+    PREC limitAngle = std::min<PREC>(steeringLimit / commandPerDegree, 89);
+    mMaxArgument = std::tan(limitAngle * static_cast<PREC>(M_PI / 180.0));
+    mNodesPerArgument = (kTableSize - 1) / mMaxArgument;
+
+    mSteering.resize(kTableSize + 1);
+    for (int32_t i = 0; i < kTableSize; ++i)
+    {
+        PREC wheelAngle = std::atan(i / mNodesPerArgument) * static_cast<PREC>(180.0 / M_PI);
+        mSteering[i] = std::min<PREC>(wheelAngle * commandPerDegree, steeringLimit);
+    }
+    mSteering[kTableSize] = mSteering[kTableSize - 1];
+
+    setSpeed(0);
+}
+
+template <typename PREC>
+void StanleyController<PREC>::setSpeed(PREC speed)
+{
+    mArgumentPerPixel = mGain * mMetersPerPixel / (std::abs(speed) * mSpeedToMps + mSofteningSpeed);
+}
+
+template <typename PREC>
+PREC StanleyController<PREC>::getControlOutput(int32_t errorFromMid)
+{
+    // atan is odd, so only the positive half is tabulated
+    PREC position = std::min(std::abs(errorFromMid * mArgumentPerPixel) * mNodesPerArgument, static_cast<PREC>(kTableSize - 1));
+    int32_t index = static_cast<int32_t>(position);
+    PREC t = position - index;
+    PREC steering = mSteering[index] + (mSteering[index + 1] - mSteering[index]) * t;
+    return errorFromMid < 0 ? -steering : steering;
+}
+
+template class StanleyController<float>;
+template class StanleyController<double>;
+} // namespace Xycar
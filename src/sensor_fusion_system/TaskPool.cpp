@@ -0,0 +1,145 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file TaskPool.cpp
+ * @version 1.0
+ * @date 2024-02-19
+ */
+
+#include <algorithm>
+
+#include "sensor_fusion_system/TaskPool.hpp"
+
+namespace Xycar {
+namespace {
+constexpr size_t kChunksPerThread = 4; ///< Chunks per thread, more chunks balance better but cost more queue traffic
+} // namespace
+
+TaskPool::TaskPool(uint32_t numWorkers)
+{
+    for (uint32_t i = 0; i <= numWorkers; ++i)
+        mQueues.emplace_back(new Queue);
+    for (uint32_t i = 0; i < numWorkers; ++i)
+        mWorkers.emplace_back(&TaskPool::work, this, i);
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_all();
+    for (std::thread& worker : mWorkers)
+        worker.join();
+}
+
+void TaskPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    const size_t numThreads = mWorkers.size() + 1;
+    if (numThreads == 1 || count == 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    Batch batch;
+    batch.remaining.store(count, std::memory_order_relaxed);
+    const size_t numChunks = std::min(count, numThreads * kChunksPerThread);
+    const uint32_t numQueues = static_cast<uint32_t>(mQueues.size());
+    // counted before they are published, so a worker popping one early never takes the count below zero
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueuedTasks.fetch_add(static_cast<uint32_t>(numChunks), std::memory_order_relaxed);
+    }
+    uint32_t queue = mNextQueue.fetch_add(1, std::memory_order_relaxed) % numQueues;
+    for (size_t chunk = 0; chunk < numChunks; ++chunk, queue = (queue + 1) % numQueues)
+    {
+        Task task = {&body, count * chunk / numChunks, count * (chunk + 1) / numChunks, &batch};
+        std::lock_guard<std::mutex> lock(mQueues[queue]->mutex);
+        mQueues[queue]->tasks.push_back(task);
+    }
+    mCondition.notify_all();
+
+    // help until the range is done, the caller queue first, then anything that is left
+    const uint32_t callerQueue = numQueues - 1;
+    Task task;
+    while (batch.remaining.load(std::memory_order_acquire) != 0)
+    {
+        if (pop(callerQueue, task) || steal(callerQueue, task))
+            execute(task);
+        else
+            std::this_thread::yield();
+    }
+    if (batch.error)
+        std::rethrow_exception(batch.error);
+}
+
+bool TaskPool::pop(uint32_t queue, Task& task)
+{
+    std::lock_guard<std::mutex> lock(mQueues[queue]->mutex);
+    if (mQueues[queue]->tasks.empty())
+        return false;
+    task = mQueues[queue]->tasks.back();
+    mQueues[queue]->tasks.pop_back();
+    mQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool TaskPool::steal(uint32_t thief, Task& task)
+{
+    const uint32_t numQueues = static_cast<uint32_t>(mQueues.size());
+    for (uint32_t offset = 1; offset < numQueues; ++offset)
+    {
+        Queue& victim = *mQueues[(thief + offset) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty())
+            continue;
+        task = victim.tasks.front();
+        victim.tasks.pop_front();
+        mQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::execute(const Task& task)
+{
+    try
+    {
+        for (size_t i = task.begin; i < task.end; ++i)
+            (*task.body)(i);
+    }
+    catch (...)
+    {
+        // a worker must not die with the exception, and the caller waits for the whole range
+        std::lock_guard<std::mutex> lock(task.batch->mutex);
+        if (!task.batch->error)
+            task.batch->error = std::current_exception();
+    }
+    task.batch->remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+}
+
+void TaskPool::work(uint32_t queue)
+{
+    Task task;
+    while (true)
+    {
+        if (pop(queue, task) || steal(queue, task))
+        {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return mQueuedTasks.load(std::memory_order_relaxed) != 0 || !mRunning; });
+        if (!mRunning)
+            return;
+    }
+}
+} // namespace Xycar
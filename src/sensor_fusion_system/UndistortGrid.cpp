@@ -0,0 +1,88 @@
+// Copyright (C) 2023 Grepp CO.
+// All rights reserved.
+
+/**
+ * @file UndistortGrid.cpp
+ * @version 1.0
+ * @date 2024-02-29
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "sensor_fusion_system/UndistortGrid.hpp"
+
+namespace Xycar {
+namespace {
+const cv::TermCriteria kSolverCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, UndistortGrid<float>::kSolverIterations, 1e-9);
+} // namespace
+
+template <typename PREC>
+void UndistortGrid<PREC>::build(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Size& imageSize)
+{
+    // one node past the last pixel, so every pixel of the image lies inside a cell
+    mCols = static_cast<int32_t>(std::ceil((imageSize.width - 1) * mInvCellSize)) + 1;
+    mRows = static_cast<int32_t>(std::ceil((imageSize.height - 1) * mInvCellSize)) + 1;
+
+    std::vector<cv::Point2f> distorted;
+    distorted.reserve(static_cast<size_t>(mCols) * mRows);
+    for (int32_t row = 0; row < mRows; ++row)
+    {
+        for (int32_t col = 0; col < mCols; ++col)
+            distorted.emplace_back(col * mCellSize, row * mCellSize);
+    }
+
+    cv::undistortPoints(distorted, mNodes, cameraMatrix, distCoeffs, cv::Mat(), cameraMatrix, kSolverCriteria);
+}
+
+template <typename PREC>
+PREC UndistortGrid<PREC>::validate(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs) const
+{
+    if (!isBuilt())
+        return static_cast<PREC>(0);
+
+    // the cell centers are the farthest from the nodes, where interpolation is worst
+    std::vector<cv::Point2f> distorted;
+    for (int32_t row = 0; row + 1 < mRows; ++row)
+    {
+        for (int32_t col = 0; col + 1 < mCols; ++col)
+            distorted.emplace_back((col + static_cast<PREC>(0.5)) * mCellSize, (row + static_cast<PREC>(0.5)) * mCellSize);
+    }
+
+    std::vector<cv::Point2f> exact;
+    cv::undistortPoints(distorted, exact, cameraMatrix, distCoeffs, cv::Mat(), cameraMatrix, kSolverCriteria);
+
+    PREC maxError = 0;
+    for (size_t i = 0; i < distorted.size(); ++i)
+    {
+        cv::Point2f diff = undistort(distorted[i]) - exact[i];
+        maxError = std::max(maxError, static_cast<PREC>(std::hypot(diff.x, diff.y)));
+    }
+    return maxError;
+}
+
+template <typename PREC>
+cv::Point2f UndistortGrid<PREC>::undistort(const cv::Point2f& point) const
+{
+    const PREC x = point.x * mInvCellSize;
+    const PREC y = point.y * mInvCellSize;
+    // the cell index is clamped but not the weights, so points past the border extrapolate linearly
+    const int32_t col = std::min(std::max(static_cast<int32_t>(std::floor(x)), 0), mCols - 2);
+    const int32_t row = std::min(std::max(static_cast<int32_t>(std::floor(y)), 0), mRows - 2);
+    const PREC tx = x - col;
+    const PREC ty = y - row;
+
+    const cv::Point2f& p00 = getNode(col, row);
+    const cv::Point2f& p10 = getNode(col + 1, row);
+    const cv::Point2f& p01 = getNode(col, row + 1);
+    const cv::Point2f& p11 = getNode(col + 1, row + 1);
+    const PREC w00 = (1 - tx) * (1 - ty);
+    const PREC w10 = tx * (1 - ty);
+    const PREC w01 = (1 - tx) * ty;
+    const PREC w11 = tx * ty;
+    return cv::Point2f(w00 * p00.x + w10 * p10.x + w01 * p01.x + w11 * p11.x, w00 * p00.y + w10 * p10.y + w01 * p01.y + w11 * p11.y);
+}
+
+template class UndistortGrid<float>;
+template class UndistortGrid<double>;
+} // namespace Xycar
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+#include "sensor_fusion_system/Recorder.hpp"
+
+// Offline estimate of the constant offset between the camera and lidar header stamps of a recording.
+// Both sensors see the same motion: the camera as optical flow magnitude, the lidar as the change of
+// the ranges between consecutive scans. The two signals are resampled on a common grid and the offset
+// with the highest normalized cross-correlation is the one to add to the camera stamps
+// (SYNC.CAMERA_TIME_OFFSET). Record a few seconds of driving or waving an object in front of both sensors.
+
+namespace {
+struct Sample
+{
+    double time;  ///< Seconds since the first record
+    double value; ///< Motion per second
+};
+
+/// Signed seconds of a stamp relative to a reference, the stamps of the other sensor may be older than the reference
+double toSeconds(uint64_t stamp, uint64_t reference)
+{
+    return static_cast<int64_t>(stamp - reference) * 1e-9;
+}
+
+/// Linear interpolation of a time sorted signal, NaN outside of it
+double interpolate(const std::vector<Sample>& signal, double time)
+{
+    if (signal.empty() || time < signal.front().time || time > signal.back().time)
+        return std::numeric_limits<double>::quiet_NaN();
+    auto upper = std::lower_bound(signal.begin(), signal.end(), time, [](const Sample& s, double t) { return s.time < t; });
+    if (upper == signal.begin())
+        return upper->value;
+    auto lower = upper - 1;
+    double weight = (time - lower->time) / std::max(upper->time - lower->time, 1e-9);
+    return lower->value + weight * (upper->value - lower->value);
+}
+
+/// Normalized cross-correlation of the lidar signal with the camera signal shifted by offset
+double correlate(const std::vector<Sample>& lidar, const std::vector<Sample>& camera, double offset, double step, uint32_t& overlap)
+{
+    std::vector<double> a, b;
+    double begin = std::max(lidar.front().time, camera.front().time + offset);
+    double end = std::min(lidar.back().time, camera.back().time + offset);
+    for (double t = begin; t <= end; t += step)
+    {
+        double l = interpolate(lidar, t);
+        double c = interpolate(camera, t - offset);
+        if (std::isfinite(l) && std::isfinite(c))
+        {
+            a.push_back(l);
+            b.push_back(c);
+        }
+    }
+    overlap = static_cast<uint32_t>(a.size());
+    if (a.size() < 3)
+        return -1.0;
+
+    double meanA = 0, meanB = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        meanA += a[i];
+        meanB += b[i];
+    }
+    meanA /= a.size();
+    meanB /= b.size();
+    double ab = 0, aa = 0, bb = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        ab += (a[i] - meanA) * (b[i] - meanB);
+        aa += (a[i] - meanA) * (a[i] - meanA);
+        bb += (b[i] - meanB) * (b[i] - meanB);
+    }
+    return aa > 0 && bb > 0 ? ab / std::sqrt(aa * bb) : -1.0;
+}
+} // namespace
+
+int32_t main(int32_t argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <config.yaml> <recording>" << std::endl;
+        return 1;
+    }
+
+    YAML::Node config = YAML::LoadFile(argv[1]);
+    const double maxOffset = config["SYNC"]["ESTIMATOR"]["MAX_OFFSET"].as<double>();
+    const double step = 1.0 / config["SYNC"]["ESTIMATOR"]["RATE"].as<double>();
+    const int32_t flowWidth = config["SYNC"]["ESTIMATOR"]["FLOW_WIDTH"].as<int32_t>();
+
+    Xycar::RecordReader reader(argv[2]);
+    if (!reader.isOpen())
+    {
+        std::cerr << "Not a recording: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::vector<Sample> camera, lidar;
+    Xycar::Record record;
+    cv::Mat frame, gray, previousGray, flow, magnitude, angle;
+    std::vector<float> ranges, previousRanges;
+    float angleMin, angleIncrement;
+    uint64_t firstStamp = 0, previousFrameStamp = 0, previousScanStamp = 0;
+
+    while (reader.next(record))
+    {
+        if (firstStamp == 0)
+            firstStamp = record.stamp;
+
+        if (record.type == Xycar::RecordType::FRAME && Xycar::Recorder::decodeFrame(record.payload, frame))
+        {
+            // flow on a small image is enough for a global motion magnitude
+            cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+            cv::resize(gray, gray, cv::Size(flowWidth, flowWidth * frame.rows / frame.cols), 0, 0, cv::INTER_AREA);
+            if (!previousGray.empty() && record.stamp > previousFrameStamp)
+            {
+                cv::calcOpticalFlowFarneback(previousGray, gray, flow, 0.5, 2, 9, 2, 5, 1.1, 0);
+                std::vector<cv::Mat> components;
+                cv::split(flow, components);
+                cv::cartToPolar(components[0], components[1], magnitude, angle);
+                double dt = (record.stamp - previousFrameStamp) * 1e-9;
+                double time = toSeconds(previousFrameStamp / 2 + record.stamp / 2, firstStamp);
+                camera.push_back({time, cv::mean(magnitude)[0] / dt});
+            }
+            std::swap(gray, previousGray);
+            previousFrameStamp = record.stamp;
+        }
+        else if (record.type == Xycar::RecordType::SCAN && Xycar::Recorder::decodeScan(record.payload, angleMin, angleIncrement, ranges))
+        {
+            if (previousRanges.size() == ranges.size() && record.stamp > previousScanStamp)
+            {
+                double change = 0;
+                uint32_t count = 0;
+                for (size_t i = 0; i < ranges.size(); ++i)
+                {
+                    if (std::isfinite(ranges[i]) && std::isfinite(previousRanges[i]))
+                    {
+                        change += std::abs(ranges[i] - previousRanges[i]);
+                        ++count;
+                    }
+                }
+                double dt = (record.stamp - previousScanStamp) * 1e-9;
+                double time = toSeconds(previousScanStamp / 2 + record.stamp / 2, firstStamp);
+                if (count > 0)
+                    lidar.push_back({time, change / count / dt});
+            }
+            std::swap(ranges, previousRanges);
+            previousScanStamp = record.stamp;
+        }
+    }
+
+    // records are written in arrival order, not stamp order
+    auto byTime = [](const Sample& a, const Sample& b) { return a.time < b.time; };
+    std::sort(camera.begin(), camera.end(), byTime);
+    std::sort(lidar.begin(), lidar.end(), byTime);
+    if (camera.size() < 3 || lidar.size() < 3)
+    {
+        std::cerr << "Not enough frames (" << camera.size() << ") or scans (" << lidar.size() << ")" << std::endl;
+        return 1;
+    }
+
+    std::vector<double> offsets, scores;
+    uint32_t overlap = 0;
+    for (double offset = -maxOffset; offset <= maxOffset + 1e-9; offset += step)
+    {
+        offsets.push_back(offset);
+        scores.push_back(correlate(lidar, camera, offset, step, overlap));
+    }
+
+    size_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+    double offset = offsets[best];
+    // parabola through the peak and its neighbours for sub-step resolution
+    if (best > 0 && best + 1 < scores.size())
+    {
+        double denominator = scores[best - 1] - 2 * scores[best] + scores[best + 1];
+        if (denominator < 0)
+            offset += 0.5 * step * (scores[best - 1] - scores[best + 1]) / denominator;
+    }
+    correlate(lidar, camera, offsets[best], step, overlap);
+
+    std::cout << "camera samples: " << camera.size() << ", lidar samples: " << lidar.size() << std::endl;
+    std::cout << "correlation at the peak: " << scores[best] << " over " << overlap * step << " s" << std::endl;
+    if (best == 0 || best + 1 == scores.size())
+        std::cout << "peak at the edge of the search range, increase SYNC.ESTIMATOR.MAX_OFFSET" << std::endl;
+    std::cout << "SYNC:" << std::endl << "  CAMERA_TIME_OFFSET: " << offset << std::endl;
+    return 0;
+}